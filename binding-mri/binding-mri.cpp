@@ -36,9 +36,13 @@
 
 #include <assert.h>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <zlib.h>
+#include <unistd.h>
 
 #include <SDL_filesystem.h>
+#include <SDL_cpuinfo.h>
 
 extern const char module_rpg1[];
 extern const char module_rpg2[];
@@ -74,6 +78,13 @@ void audioBindingInit();
 void graphicsBindingInit();
 
 void fileIntBindingInit();
+void marshalLoadBindingInit();
+void rpgCacheBindingInit();
+void pathfinderBindingInit();
+void profilerBindingInit();
+
+void profilerAddScriptName(const char *filename, const char *scriptName);
+void profilerShutdown();
 
 RB_METHOD(mriPrint);
 RB_METHOD(mriP);
@@ -112,6 +123,9 @@ static void mriBindingInit()
 	graphicsBindingInit();
 
 	fileIntBindingInit();
+	marshalLoadBindingInit();
+	pathfinderBindingInit();
+	profilerBindingInit();
 
 	if (rgssVer >= 3)
 	{
@@ -133,7 +147,10 @@ static void mriBindingInit()
 	}
 
 	if (rgssVer == 1)
+	{
 		rb_eval_string(module_rpg1);
+		rpgCacheBindingInit();
+	}
 	else if (rgssVer == 2)
 		rb_eval_string(module_rpg2);
 	else if (rgssVer == 3)
@@ -378,6 +395,316 @@ struct BacktraceData
 
 #define SCRIPT_SECTION_FMT (rgssVer >= 3 ? "{%04ld}" : "Section%03ld")
 
+/* Inflates all script sections at once, spread over
+ * as many threads as there are CPUs */
+struct ScriptInflater
+{
+	struct Job
+	{
+		const unsigned char *source;
+		unsigned long sourceLen;
+
+		std::string text;
+		int result;
+	};
+
+	std::vector<Job> jobs;
+	SDL_atomic_t next;
+
+	void run()
+	{
+		SDL_AtomicSet(&next, 0);
+
+		int threadCount = std::min<int>(SDL_GetCPUCount(), jobs.size() / 16 + 1);
+		std::vector<SDL_Thread*> threads;
+
+		for (int i = 1; i < threadCount; ++i)
+		{
+			SDL_Thread *thread =
+			        createSDLThread<ScriptInflater, &ScriptInflater::work>(this, "scriptinflate");
+
+			if (thread)
+				threads.push_back(thread);
+		}
+
+		/* Lend a hand while waiting */
+		work();
+
+		for (size_t i = 0; i < threads.size(); ++i)
+			SDL_WaitThread(threads[i], 0);
+	}
+
+	void work()
+	{
+		size_t i;
+
+		while ((i = SDL_AtomicAdd(&next, 1)) < jobs.size())
+			inflate(jobs[i]);
+	}
+
+	static void inflate(Job &job)
+	{
+		if (!job.source)
+		{
+			job.result = Z_OK;
+			return;
+		}
+
+		/* Scripts usually compress to about a fourth */
+		std::string &buffer = job.text;
+		buffer.resize(std::max<unsigned long>(job.sourceLen * 4, 0x1000));
+
+		while (true)
+		{
+			unsigned long bufferLen = buffer.size();
+
+			job.result = uncompress(reinterpret_cast<unsigned char*>(&buffer[0]), &bufferLen,
+			                        job.source, job.sourceLen);
+
+			if (job.result != Z_BUF_ERROR)
+			{
+				buffer.resize(bufferLen);
+				break;
+			}
+
+			buffer.resize(buffer.size()*2);
+		}
+	}
+};
+
+#define SCRIPT_CACHE_VER 1
+
+/* Keeps compiled scripts (RubyVM::InstructionSequence binaries)
+ * around between launches, so they don't have to be parsed anew.
+ * Entries are keyed by a hash of their source and file name,
+ * and the whole cache is discarded when the ruby build differs */
+struct ScriptCache
+{
+	std::string path;
+	std::string rubyVersion;
+
+	/* Loaded from disk */
+	BoostHash<uint64_t, std::string> entries;
+	size_t entryCount;
+
+	/* Entries used during this run, to be written back */
+	std::vector<std::pair<uint64_t, VALUE> > used;
+	bool dirty;
+
+	VALUE iseqClass;
+
+	ScriptCache()
+	    : entryCount(0),
+	      dirty(false),
+	      iseqClass(Qnil)
+	{}
+
+	/* Returns false if this ruby can't serialize compiled code */
+	bool init(const std::string &dataDir)
+	{
+		VALUE vm = rb_const_get(rb_cObject, rb_intern("RubyVM"));
+		iseqClass = rb_const_get(vm, rb_intern("InstructionSequence"));
+
+		if (!rb_respond_to(iseqClass, rb_intern("load_from_binary")))
+			return false;
+
+		VALUE desc = rb_const_get(rb_cObject, rb_intern("RUBY_DESCRIPTION"));
+		rubyVersion = std::string(RSTRING_PTR(desc), RSTRING_LEN(desc));
+
+		char buffer[1024];
+		std::string gameDir = getcwd(buffer, sizeof(buffer)) ? buffer : "";
+
+		char name[32];
+		snprintf(name, sizeof(name), "scripts-%08x.mkxp", (uint32_t) hash(gameDir));
+		path = dataDir + name;
+
+		read();
+
+		return true;
+	}
+
+	/* FNV-1a */
+	static uint64_t hash(const std::string &str, uint64_t value = 14695981039346656037ull)
+	{
+		for (size_t i = 0; i < str.size(); ++i)
+			value = (value ^ (uint8_t) str[i]) * 1099511628211ull;
+
+		return value;
+	}
+
+	static uint64_t key(const std::string &source, const std::string &fname)
+	{
+		return hash(fname, hash(source) ^ source.size());
+	}
+
+	/* Returns the compiled script, or nil if it fails to compile
+	 * (in which case evaluating it will report the error) */
+	VALUE compile(const std::string &source, VALUE string, VALUE fname)
+	{
+		uint64_t k = key(source, std::string(RSTRING_PTR(fname), RSTRING_LEN(fname)));
+		VALUE iseq = Qnil;
+
+		BoostHash<uint64_t, std::string>::const_iterator iter = entries.find(k);
+
+		if (iter != entries.cend())
+		{
+			VALUE binary = rb_str_new(iter->second.c_str(), iter->second.size());
+			VALUE args[] = { iseqClass, binary };
+			iseq = protect(loadHelper, args);
+		}
+
+		if (NIL_P(iseq))
+		{
+			VALUE args[] = { iseqClass, string, fname };
+			iseq = protect(compileHelper, args);
+
+			if (NIL_P(iseq))
+				return Qnil;
+
+			dirty = true;
+		}
+
+		used.push_back(std::make_pair(k, iseq));
+
+		return iseq;
+	}
+
+	/* Serializes all used entries; this drops stale ones */
+	void write()
+	{
+		if (!dirty && used.size() == entryCount)
+			return;
+
+		std::string data;
+		append(data, SCRIPT_CACHE_VER);
+		append(data, rubyVersion);
+		append(data, used.size());
+
+		for (size_t i = 0; i < used.size(); ++i)
+		{
+			VALUE args[] = { used[i].second };
+			VALUE binary = protect(binaryHelper, args);
+
+			if (NIL_P(binary))
+				return;
+
+			append(data, used[i].first);
+			append(data, std::string(RSTRING_PTR(binary), RSTRING_LEN(binary)));
+		}
+
+		FILE *f = fopen(path.c_str(), "wb");
+
+		if (!f)
+			return;
+
+		fwrite(data.c_str(), 1, data.size(), f);
+		fclose(f);
+	}
+
+private:
+	void read()
+	{
+		std::string data;
+
+		if (!readFileSDL(path.c_str(), data))
+			return;
+
+		size_t pos = 0;
+		uint64_t ver, count;
+		std::string version;
+
+		if (!take(data, pos, ver) || ver != SCRIPT_CACHE_VER)
+			return;
+
+		if (!take(data, pos, version) || version != rubyVersion)
+			return;
+
+		if (!take(data, pos, count))
+			return;
+
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			uint64_t k;
+			std::string binary;
+
+			if (!take(data, pos, k) || !take(data, pos, binary))
+				return;
+
+			entries.insert(k, binary);
+			++entryCount;
+		}
+	}
+
+	static void append(std::string &data, uint64_t value)
+	{
+		data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	static void append(std::string &data, const std::string &str)
+	{
+		append(data, str.size());
+		data.append(str);
+	}
+
+	static bool take(const std::string &data, size_t &pos, uint64_t &value)
+	{
+		if (data.size() - pos < sizeof(value))
+			return false;
+
+		memcpy(&value, &data[pos], sizeof(value));
+		pos += sizeof(value);
+
+		return true;
+	}
+
+	static bool take(const std::string &data, size_t &pos, std::string &str)
+	{
+		uint64_t len;
+
+		if (!take(data, pos, len) || data.size() - pos < len)
+			return false;
+
+		str.assign(data, pos, len);
+		pos += len;
+
+		return true;
+	}
+
+	static VALUE loadHelper(VALUE *args)
+	{
+		return rb_funcall(args[0], rb_intern("load_from_binary"), 1, args[1]);
+	}
+
+	static VALUE compileHelper(VALUE *args)
+	{
+		return rb_funcall(args[0], rb_intern("compile"), 2, args[1], args[2]);
+	}
+
+	static VALUE binaryHelper(VALUE *args)
+	{
+		return rb_funcall(args[0], rb_intern("to_binary"), 0);
+	}
+
+	/* Errors are not fatal here, we can always fall back to eval */
+	static VALUE protect(VALUE (*func)(VALUE*), VALUE *args)
+	{
+		int state;
+		VALUE result = rb_protect((VALUE (*)(VALUE)) func, (VALUE) args, &state);
+
+		if (!state)
+			return result;
+
+		rb_set_errinfo(Qnil);
+
+		return Qnil;
+	}
+};
+
+static VALUE iseqEvalHelper(VALUE iseq)
+{
+	return rb_funcall(iseq, rb_intern("eval"), 0);
+}
+
 static void runRMXPScripts(BacktraceData &btData)
 {
 	const Config &conf = shState->rtData().config;
@@ -419,44 +746,41 @@ static void runRMXPScripts(BacktraceData &btData)
 
 	long scriptCount = RARRAY_LEN(scriptArray);
 
-	std::string decodeBuffer;
-	decodeBuffer.resize(0x1000);
+	ScriptInflater inflater;
+	inflater.jobs.resize(scriptCount);
 
 	for (long i = 0; i < scriptCount; ++i)
 	{
 		VALUE script = rb_ary_entry(scriptArray, i);
+		ScriptInflater::Job &job = inflater.jobs[i];
+
+		job.source = 0;
 
 		if (!RB_TYPE_P(script, RUBY_T_ARRAY))
 			continue;
 
-		VALUE scriptName   = rb_ary_entry(script, 1);
 		VALUE scriptString = rb_ary_entry(script, 2);
 
-		int result = Z_OK;
-		unsigned long bufferLen;
-
-		while (true)
-		{
-			unsigned char *bufferPtr =
-			        reinterpret_cast<unsigned char*>(const_cast<char*>(decodeBuffer.c_str()));
-			const unsigned char *sourcePtr =
-			        reinterpret_cast<const unsigned char*>(RSTRING_PTR(scriptString));
-
-			bufferLen = decodeBuffer.length();
-
-			result = uncompress(bufferPtr, &bufferLen,
-			                    sourcePtr, RSTRING_LEN(scriptString));
+		job.source = reinterpret_cast<const unsigned char*>(RSTRING_PTR(scriptString));
+		job.sourceLen = RSTRING_LEN(scriptString);
+	}
 
-			bufferPtr[bufferLen] = '\0';
+	/* The workers only read the compressed strings, which
+	 * can't move as we don't run any ruby code meanwhile */
+	inflater.run();
 
-			if (result != Z_BUF_ERROR)
-				break;
+	for (long i = 0; i < scriptCount; ++i)
+	{
+		VALUE script = rb_ary_entry(scriptArray, i);
+		ScriptInflater::Job &job = inflater.jobs[i];
 
-			decodeBuffer.resize(decodeBuffer.size()*2);
-		}
+		if (!job.source)
+			continue;
 
-		if (result != Z_OK)
+		if (job.result != Z_OK)
 		{
+			VALUE scriptName = rb_ary_entry(script, 1);
+
 			static char buffer[256];
 			snprintf(buffer, sizeof(buffer), "Error decoding script %ld: '%s'",
 			         i, RSTRING_PTR(scriptName));
@@ -466,9 +790,11 @@ static void runRMXPScripts(BacktraceData &btData)
 			break;
 		}
 
-		rb_ary_store(script, 3, rb_str_new_cstr(decodeBuffer.c_str()));
+		rb_ary_store(script, 3, rb_str_new_cstr(job.text.c_str()));
 	}
 
+	inflater.jobs.clear();
+
 	/* Execute preloaded scripts */
 	for (std::set<std::string>::iterator i = conf.preloadScripts.begin();
 	     i != conf.preloadScripts.end(); ++i)
@@ -478,30 +804,78 @@ static void runRMXPScripts(BacktraceData &btData)
 	if (exc != Qnil)
 		return;
 
+	/* Compile everything upfront, so the cache can be
+	 * written before the game enters its main loop */
+	VALUE fnames = rb_ary_new();
+	VALUE compiled = rb_ary_new();
+
+	ScriptCache cache;
+	bool useCache = false;
+
+	if (conf.scriptCache)
+	{
+		const std::string &dataPath = conf.customDataPath.empty()
+		        ? conf.commonDataPath : conf.customDataPath;
+
+		useCache = cache.init(dataPath);
+	}
+
+	for (long i = 0; i < scriptCount; ++i)
+	{
+		VALUE script = rb_ary_entry(scriptArray, i);
+		VALUE scriptDecoded = rb_ary_entry(script, 3);
+
+		const char *scriptName = RSTRING_PTR(rb_ary_entry(script, 1));
+		char buf[512];
+		int len;
+
+		if (conf.useScriptNames)
+			len = snprintf(buf, sizeof(buf), "%03ld:%s", i, scriptName);
+		else
+			len = snprintf(buf, sizeof(buf), SCRIPT_SECTION_FMT, i);
+
+		VALUE fname = newStringUTF8(buf, len);
+		rb_ary_push(fnames, fname);
+		btData.scriptNames.insert(buf, scriptName);
+		profilerAddScriptName(buf, scriptName);
+
+		if (!useCache || NIL_P(scriptDecoded))
+		{
+			rb_ary_push(compiled, Qnil);
+			continue;
+		}
+
+		std::string source(RSTRING_PTR(scriptDecoded), RSTRING_LEN(scriptDecoded));
+		VALUE string = newStringUTF8(source.c_str(), source.size());
+
+		rb_ary_push(compiled, cache.compile(source, string, fname));
+	}
+
+	if (useCache)
+		cache.write();
+
 	while (true)
 	{
 		for (long i = 0; i < scriptCount; ++i)
 		{
-			VALUE script = rb_ary_entry(scriptArray, i);
-			VALUE scriptDecoded = rb_ary_entry(script, 3);
-			VALUE string = newStringUTF8(RSTRING_PTR(scriptDecoded),
-			                             RSTRING_LEN(scriptDecoded));
-
-			VALUE fname;
-			const char *scriptName = RSTRING_PTR(rb_ary_entry(script, 1));
-			char buf[512];
-			int len;
-
-			if (conf.useScriptNames)
-				len = snprintf(buf, sizeof(buf), "%03ld:%s", i, scriptName);
+			VALUE iseq = rb_ary_entry(compiled, i);
+
+			int state;
+
+			if (!NIL_P(iseq))
+			{
+				rb_protect(iseqEvalHelper, iseq, &state);
+			}
 			else
-				len = snprintf(buf, sizeof(buf), SCRIPT_SECTION_FMT, i);
+			{
+				VALUE script = rb_ary_entry(scriptArray, i);
+				VALUE scriptDecoded = rb_ary_entry(script, 3);
+				VALUE string = newStringUTF8(RSTRING_PTR(scriptDecoded),
+				                             RSTRING_LEN(scriptDecoded));
 
-			fname = newStringUTF8(buf, len);
-			btData.scriptNames.insert(buf, scriptName);
+				evalString(string, rb_ary_entry(fnames, i), &state);
+			}
 
-			int state;
-			evalString(string, fname, &state);
 			if (state)
 				break;
 		}
@@ -512,6 +886,9 @@ static void runRMXPScripts(BacktraceData &btData)
 
 		processReset();
 	}
+
+	RB_GC_GUARD(fnames);
+	RB_GC_GUARD(compiled);
 }
 
 static void showExc(VALUE exc, const BacktraceData &btData)
@@ -617,6 +994,8 @@ static void mriBindingExecute()
 	if (!NIL_P(exc) && !rb_obj_is_kind_of(exc, rb_eSystemExit))
 		showExc(exc, btData);
 
+	profilerShutdown();
+
 	ruby_cleanup(0);
 
 	shState->rtData().rqTermAck.set();
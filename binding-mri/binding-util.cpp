@@ -23,11 +23,15 @@
 
 #include "sharedstate.h"
 #include "exception.h"
+#include "texpool.h"
+#include "imagecache.h"
+#include "config.h"
 #include "util.h"
 
 #include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 
 RbData *getRbData()
 {
@@ -45,7 +49,14 @@ struct
 	{ SDL,    "SDLError"    }
 };
 
+/* rb_gc_adjust_memory_usage() was added in 2.4 */
+#if RUBY_API_VERSION_MAJOR > 2 || (RUBY_API_VERSION_MAJOR == 2 && RUBY_API_VERSION_MINOR >= 4)
+#  define HAVE_GC_ADJUST_MEMORY_USAGE
+#endif
+
 RbData::RbData()
+    : texMemReported(0),
+      texMemGCTrigger(0)
 {
 	for (size_t i = 0; i < ARRAY_SIZE(customExc); ++i)
 		exc[customExc[i].id] = rb_define_class(customExc[i].name, rb_eException);
@@ -99,6 +110,45 @@ raiseDisposedAccess(VALUE self)
 	rb_raise(getRbData()->exc[RGSS], "disposed %s", buf);
 }
 
+static uint64_t
+texMemUsed()
+{
+	return shState->texPool().usedMemSize() - shState->imageCache().retainedMemSize();
+}
+
+void
+reportTexMemory()
+{
+	RbData *data = getRbData();
+
+	uint64_t used = texMemUsed();
+	const uint64_t watermark = (uint64_t) std::max(shState->config().vramGCWatermark, 0) * 1024 * 1024;
+
+	if (watermark > 0)
+	{
+		if (used <= watermark)
+			data->texMemGCTrigger = watermark;
+
+		if (used > data->texMemGCTrigger)
+		{
+			/* Finalizes all unreachable bitmaps right away */
+			rb_gc();
+
+			/* If the textures are still in use, don't keep
+			 * collecting on every single allocation */
+			used = texMemUsed();
+			data->texMemGCTrigger = std::max(watermark, used + watermark / 2);
+		}
+	}
+
+#ifdef HAVE_GC_ADJUST_MEMORY_USAGE
+	if (used != data->texMemReported)
+		rb_gc_adjust_memory_usage((ssize_t) (used - data->texMemReported));
+#endif
+
+	data->texMemReported = used;
+}
+
 int
 rb_get_args(int argc, VALUE *argv, const char *format, ...)
 {
@@ -23,6 +23,7 @@
 #define BINDING_UTIL_H
 
 #include <ruby.h>
+#include <ruby/thread.h>
 
 #include "exception.h"
 
@@ -51,6 +52,11 @@ struct RbData
 	/* Input module (RGSS3) */
 	VALUE buttoncodeHash;
 
+	/* Texture memory last reported to the GC */
+	uint64_t texMemReported;
+	/* Texture memory above which a GC is forced */
+	uint64_t texMemGCTrigger;
+
 	RbData();
 	~RbData();
 };
@@ -107,6 +113,15 @@ static void freeInstance(void *inst)
 void
 raiseDisposedAccess(VALUE self);
 
+/* Tells the GC how much texture memory is held, which it can't
+ * see behind the small Bitmap objects, and forces a collection
+ * when the 'vramGCWatermark' is crossed. Textures only retained
+ * by the image cache don't count. Called on every Graphics.update,
+ * which sees all changes since the last frame, and right after
+ * creating bitmaps so loops that don't update still collect */
+void
+reportTexMemory();
+
 template<class C>
 inline C *
 getPrivateData(VALUE self)
@@ -130,6 +145,12 @@ setPrivateData(VALUE self, void *p)
 	RTYPEDDATA_DATA(self) = p;
 }
 
+/* Evaluates to the interned ID of 'name', looking it up only
+ * once per call site. rb_intern(), and with it rb_iv_get()/rb_iv_set(),
+ * have to hash the name string on every call */
+#define RB_ID(name) \
+	([]() -> ID { static const ID id = rb_intern(name); return id; }())
+
 inline VALUE
 wrapObject(void *p, const rb_data_type_t &type,
            VALUE underKlass = rb_cObject)
@@ -189,6 +210,25 @@ _rb_define_module_function(VALUE module, const char *name, RubyMethod func)
 #define GUARD_EXC(exp) \
 { try { exp } catch (const Exception &exc) { raiseRbExc(exc); } }
 
+template<class F>
+static void *
+callWithoutGVL(void *fun)
+{
+	(*static_cast<F*>(fun))();
+
+	return 0;
+}
+
+/* Runs 'fun' with the GVL released, so other Ruby threads can
+ * keep going while it blocks. 'fun' must neither touch any Ruby
+ * objects nor throw */
+template<class F>
+inline void
+withoutGVL(F fun)
+{
+	rb_thread_call_without_gvl(callWithoutGVL<F>, &fun, 0, 0);
+}
+
 template<class C>
 static inline VALUE
 objectLoad(int argc, VALUE *argv, VALUE self)
@@ -278,6 +318,54 @@ rb_check_argc(int actual, int expected)
 		         actual, expected);
 }
 
+/* Typed counterparts of the 'i', 'f', 'b' and 'o' format characters */
+inline void
+rb_typed_arg(VALUE arg, int *out, int argPos)
+{
+	rb_int_arg(arg, out, argPos);
+}
+
+inline void
+rb_typed_arg(VALUE arg, double *out, int argPos)
+{
+	rb_float_arg(arg, out, argPos);
+}
+
+inline void
+rb_typed_arg(VALUE arg, bool *out, int argPos)
+{
+	rb_bool_arg(arg, out, argPos);
+}
+
+inline void
+rb_typed_arg(VALUE arg, VALUE *out, int)
+{
+	*out = arg;
+}
+
+inline void
+rb_unpack_args(VALUE *, int)
+{}
+
+template<typename T, typename... Rest>
+inline void
+rb_unpack_args(VALUE *argv, int argPos, T *out, Rest*... rest)
+{
+	rb_typed_arg(argv[argPos], out, argPos);
+	rb_unpack_args(argv, argPos+1, rest...);
+}
+
+/* For hot methods taking a fixed number of arguments: the
+ * conversions are picked at compile time from the argument
+ * types, instead of parsing a format string on every call */
+template<typename... Args>
+inline void
+rb_get_args_fixed(int argc, VALUE *argv, Args*... out)
+{
+	rb_check_argc(argc, sizeof...(Args));
+	rb_unpack_args(argv, 0, out...);
+}
+
 #define RB_METHOD(name) \
 	static VALUE name(int argc, VALUE *argv, VALUE self)
 
@@ -312,7 +400,7 @@ rb_check_argc(int actual, int expected)
 	RB_METHOD(Klass##Get##PropName) \
 	{ \
 		RB_UNUSED_PARAM; \
-		return rb_iv_get(self, prop_iv); \
+		return rb_ivar_get(self, RB_ID(prop_iv)); \
 	} \
 	RB_METHOD(Klass##Set##PropName) \
 	{ \
@@ -326,7 +414,7 @@ rb_check_argc(int actual, int expected)
 		else \
 			prop = getPrivateDataCheck<PropKlass>(propObj, PropKlass##Type); \
 		GUARD_EXC( k->set##PropName(prop); ) \
-		rb_iv_set(self, prop_iv, propObj); \
+		rb_ivar_set(self, RB_ID(prop_iv), propObj); \
 		return propObj; \
 	}
 
@@ -336,7 +424,7 @@ rb_check_argc(int actual, int expected)
 	{ \
 		RB_UNUSED_PARAM; \
 		checkDisposed<Klass>(self); \
-		return rb_iv_get(self, prop_iv); \
+		return rb_ivar_get(self, RB_ID(prop_iv)); \
 	} \
 	RB_METHOD(Klass##Set##PropName) \
 	{ \
@@ -349,6 +437,24 @@ rb_check_argc(int actual, int expected)
 		return propObj; \
 	}
 
+/* Sets the components of a Color / Tone / Rect property in place,
+ * eg. 'sprite.set_tone(r, g, b)', so scripts don't have to allocate
+ * a temporary object every frame. The last component is optional
+ * if 'min_argc' is 3 */
+#define DEF_PROP_OBJ_SET(Klass, PropName, type, min_argc, last_def) \
+	RB_METHOD(Klass##SetIn##PropName) \
+	{ \
+		if (argc < min_argc || argc > 4) \
+			rb_raise(rb_eArgError, "wrong number of arguments (%d for %d..4)", \
+			         argc, min_argc); \
+		Klass *k = getPrivateData<Klass>(self); \
+		type v[4] = { 0, 0, 0, last_def }; \
+		for (int i = 0; i < argc; ++i) \
+			rb_typed_arg(argv[i], &v[i], i); \
+		GUARD_EXC( k->get##PropName().set(v[0], v[1], v[2], v[3]); ) \
+		return self; \
+	}
+
 #define DEF_PROP(Klass, type, PropName, arg_fun, value_fun) \
 	RB_METHOD(Klass##Get##PropName) \
 	{ \
@@ -383,5 +489,8 @@ rb_check_argc(int actual, int expected)
 	_rb_define_method(klass, prop_name_s "=", Klass##Set##PropName); \
 }
 
+#define INIT_PROP_SET_BIND(Klass, PropName, prop_name_s) \
+	_rb_define_method(klass, "set_" prop_name_s, Klass##SetIn##PropName)
+
 
 #endif // BINDING_UTIL_H
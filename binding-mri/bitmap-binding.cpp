@@ -27,6 +27,8 @@
 #include "binding-util.h"
 #include "binding-types.h"
 
+#include <string>
+
 DEF_TYPE(Bitmap);
 
 static const char *objAsStringPtr(VALUE obj)
@@ -45,7 +47,7 @@ void bitmapInitProps(Bitmap *b, VALUE self)
 	Font *font = getPrivateData<Font>(fontObj);
 	b->setInitFont(font);
 
-	rb_iv_set(self, "font", fontObj);
+	rb_ivar_set(self, RB_ID("font"), fontObj);
 }
 
 RB_METHOD(bitmapInitialize)
@@ -57,6 +59,14 @@ RB_METHOD(bitmapInitialize)
 		char *filename;
 		rb_get_args(argc, argv, "z", &filename RB_ARG_END);
 
+		/* Decode without holding the GVL, so other
+		 * Ruby threads can keep running meanwhile */
+		if (!Bitmap::isCached(filename))
+		{
+			const std::string path(filename);
+			withoutGVL([&]() { Bitmap::decode(path.c_str()); });
+		}
+
 		GUARD_EXC( b = new Bitmap(filename); )
 	}
 	else
@@ -70,9 +80,59 @@ RB_METHOD(bitmapInitialize)
 	setPrivateData(self, b);
 	bitmapInitProps(b, self);
 
+	reportTexMemory();
+
 	return self;
 }
 
+/* Accepts any number of filenames and/or arrays of filenames */
+RB_METHOD(bitmapPreload)
+{
+	RB_UNUSED_PARAM;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		VALUE arg = argv[i];
+
+		if (RB_TYPE_P(arg, T_ARRAY))
+		{
+			for (long j = 0; j < RARRAY_LEN(arg); ++j)
+			{
+				VALUE entry = rb_ary_entry(arg, j);
+				Bitmap::preload(StringValueCStr(entry));
+			}
+		}
+		else
+		{
+			Bitmap::preload(StringValueCStr(arg));
+		}
+	}
+
+	return Qnil;
+}
+
+/* Decodes 'filename' on the calling Ruby thread without holding
+ * the GVL, so a following Bitmap.new on the main thread only has
+ * to upload it. Meant for loading in the background with plain
+ * Ruby threads, which must not create Bitmaps themselves */
+RB_METHOD(bitmapDecode)
+{
+	RB_UNUSED_PARAM;
+
+	const char *filename;
+	rb_get_args(argc, argv, "z", &filename RB_ARG_END);
+
+	if (Bitmap::isCached(filename))
+		return Qtrue;
+
+	const std::string path(filename);
+	bool success = false;
+
+	withoutGVL([&]() { success = Bitmap::decode(path.c_str()); });
+
+	return rb_bool_new(success);
+}
+
 RB_METHOD(bitmapWidth)
 {
 	RB_UNUSED_PARAM;
@@ -189,6 +249,71 @@ RB_METHOD(bitmapFillRect)
 	return self;
 }
 
+/* Fill entries are arrays of the form [rect, color(, color2(, vertical))]
+ * or [x, y, width, height, color(, color2(, vertical))], with the
+ * presence of 'color2' making it a gradient fill */
+static void fillOpFromEntry(VALUE entry, Bitmap::FillOp &op)
+{
+	Check_Type(entry, T_ARRAY);
+
+	long len = RARRAY_LEN(entry);
+	long i;
+
+	if (len >= 5 && FIXNUM_P(rb_ary_entry(entry, 0)))
+	{
+		int x, y, width, height;
+		rb_int_arg(rb_ary_entry(entry, 0), &x, 1);
+		rb_int_arg(rb_ary_entry(entry, 1), &y, 2);
+		rb_int_arg(rb_ary_entry(entry, 2), &width, 3);
+		rb_int_arg(rb_ary_entry(entry, 3), &height, 4);
+
+		op.rect = IntRect(x, y, width, height);
+		i = 4;
+	}
+	else if (len >= 2)
+	{
+		Rect *rect = getPrivateDataCheck<Rect>(rb_ary_entry(entry, 0), RectType);
+
+		op.rect = rect->toIntRect();
+		i = 1;
+	}
+	else
+	{
+		rb_raise(rb_eArgError, "malformed fill entry");
+	}
+
+	op.color1 = getPrivateDataCheck<Color>(rb_ary_entry(entry, i++), ColorType)->norm;
+
+	if (i < len)
+	{
+		op.gradient = true;
+		op.color2 = getPrivateDataCheck<Color>(rb_ary_entry(entry, i++), ColorType)->norm;
+
+		if (i < len)
+			rb_bool_arg(rb_ary_entry(entry, i), &op.vertical, i+1);
+	}
+}
+
+RB_METHOD(bitmapFillRects)
+{
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	VALUE entriesObj;
+
+	rb_get_args(argc, argv, "o", &entriesObj RB_ARG_END);
+
+	Check_Type(entriesObj, T_ARRAY);
+
+	std::vector<Bitmap::FillOp> ops(RARRAY_LEN(entriesObj));
+
+	for (size_t i = 0; i < ops.size(); ++i)
+		fillOpFromEntry(rb_ary_entry(entriesObj, i), ops[i]);
+
+	GUARD_EXC( b->fillRects(ops); );
+
+	return self;
+}
+
 RB_METHOD(bitmapClear)
 {
 	RB_UNUSED_PARAM;
@@ -206,7 +331,7 @@ RB_METHOD(bitmapGetPixel)
 
 	int x, y;
 
-	rb_get_args(argc, argv, "ii", &x, &y RB_ARG_END);
+	rb_get_args_fixed(argc, argv, &x, &y);
 
 	Color value;
 	GUARD_EXC( value = b->getPixel(x, y); );
@@ -225,7 +350,7 @@ RB_METHOD(bitmapSetPixel)
 
 	Color *color;
 
-	rb_get_args(argc, argv, "iio", &x, &y, &colorObj RB_ARG_END);
+	rb_get_args_fixed(argc, argv, &x, &y, &colorObj);
 
 	color = getPrivateDataCheck<Color>(colorObj, ColorType);
 
@@ -430,6 +555,8 @@ RB_METHOD(bitmapInitializeCopy)
 
 	setPrivateData(self, b);
 
+	reportTexMemory();
+
 	return self;
 }
 
@@ -445,12 +572,16 @@ bitmapBindingInit()
 	_rb_define_method(klass, "initialize",      bitmapInitialize);
 	_rb_define_method(klass, "initialize_copy", bitmapInitializeCopy);
 
+	rb_define_class_method(klass, "preload", bitmapPreload);
+	rb_define_class_method(klass, "decode", bitmapDecode);
+
 	_rb_define_method(klass, "width",       bitmapWidth);
 	_rb_define_method(klass, "height",      bitmapHeight);
 	_rb_define_method(klass, "rect",        bitmapRect);
 	_rb_define_method(klass, "blt",         bitmapBlt);
 	_rb_define_method(klass, "stretch_blt", bitmapStretchBlt);
 	_rb_define_method(klass, "fill_rect",   bitmapFillRect);
+	_rb_define_method(klass, "fill_rects",  bitmapFillRects);
 	_rb_define_method(klass, "clear",       bitmapClear);
 	_rb_define_method(klass, "get_pixel",   bitmapGetPixel);
 	_rb_define_method(klass, "set_pixel",   bitmapSetPixel);
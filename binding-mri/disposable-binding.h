@@ -31,12 +31,12 @@
 inline void
 disposableAddChild(VALUE disp, VALUE child)
 {
-	VALUE children = rb_iv_get(disp, "children");
+	VALUE children = rb_ivar_get(disp, RB_ID("children"));
 
 	if (NIL_P(children))
 	{
 		children = rb_ary_new();
-		rb_iv_set(disp, "children", children);
+		rb_ivar_set(disp, RB_ID("children"), children);
 	}
 
 	/* Assumes children are never removed until destruction */
@@ -46,12 +46,12 @@ disposableAddChild(VALUE disp, VALUE child)
 inline void
 disposableDisposeChildren(VALUE disp)
 {
-	VALUE children = rb_iv_get(disp, "children");
+	VALUE children = rb_ivar_get(disp, RB_ID("children"));
 
 	if (NIL_P(children))
 		return;
 
-	ID dispFun = rb_intern("_mkxp_dispose_alias");
+	ID dispFun = RB_ID("_mkxp_dispose_alias");
 
 	for (long i = 0; i < RARRAY_LEN(children); ++i)
 		rb_funcall2(rb_ary_entry(children, i), dispFun, 0, 0);
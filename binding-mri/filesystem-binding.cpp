@@ -23,21 +23,100 @@
 
 #include "sharedstate.h"
 #include "filesystem.h"
+#include "savewriter.h"
+#include "config.h"
+#include "boost-hash.h"
 #include "util.h"
 
+#include <list>
+#include <string>
+#include <limits.h>
+
 #include "ruby/encoding.h"
 #include "ruby/intern.h"
 
-static void
-fileIntFreeInstance(void *inst)
+/* Marshal issues lots of tiny reads (one per byte
+ * via 'getbyte'), so FileInt reads through a buffer */
+#define FILEINT_BUFFER_SIZE 0x10000
+
+/* Data files up to this size are read into memory
+ * as a whole and parsed from a string instead */
+#define LOAD_DATA_MEM_MAX (32 * 1024 * 1024)
+
+struct FileInt
 {
-	SDL_RWops *ops = static_cast<SDL_RWops*>(inst);
+	SDL_RWops *ops;
 
-	SDL_RWclose(ops);
-	SDL_FreeRW(ops);
-}
+	char buffer[FILEINT_BUFFER_SIZE];
+	size_t bufferPos;
+	size_t bufferLen;
+
+	/* Set while a read runs without the GVL, during which
+	 * other threads mustn't touch the file */
+	bool busy;
+
+	FileInt(SDL_RWops *ops)
+	    : ops(ops),
+	      bufferPos(0),
+	      bufferLen(0),
+	      busy(false)
+	{}
+
+	~FileInt()
+	{
+		SDL_RWclose(ops);
+		SDL_FreeRW(ops);
+	}
+
+	size_t read(void *dest, size_t len)
+	{
+		char *out = static_cast<char*>(dest);
+		size_t done = 0;
+
+		while (done < len)
+		{
+			if (bufferPos < bufferLen)
+			{
+				size_t count = std::min(len - done, bufferLen - bufferPos);
+				memcpy(out + done, buffer + bufferPos, count);
+
+				bufferPos += count;
+				done += count;
+
+				continue;
+			}
+
+			/* Large reads bypass the buffer */
+			if (len - done >= sizeof(buffer))
+			{
+				done += SDL_RWread(ops, out + done, 1, len - done);
+				break;
+			}
 
-DEF_TYPE_CUSTOMFREE(FileInt, fileIntFreeInstance);
+			bufferPos = 0;
+			bufferLen = SDL_RWread(ops, buffer, 1, sizeof(buffer));
+
+			if (bufferLen == 0)
+				break;
+		}
+
+		return done;
+	}
+
+	/* Bytes left until the end of file */
+	Sint64 remaining()
+	{
+		Sint64 end = SDL_RWsize(ops);
+		Sint64 cur = SDL_RWtell(ops);
+
+		if (end < 0 || cur < 0)
+			return -1;
+
+		return end - cur + (bufferLen - bufferPos);
+	}
+};
+
+DEF_TYPE(FileInt);
 
 static VALUE
 fileIntForPath(const char *path, bool rubyExc)
@@ -62,43 +141,75 @@ fileIntForPath(const char *path, bool rubyExc)
 
 	VALUE obj = rb_obj_alloc(klass);
 
-	setPrivateData(obj, ops);
+	setPrivateData(obj, new FileInt(ops));
 
 	return obj;
 }
 
+static FileInt *
+getIdleFileInt(VALUE self)
+{
+	FileInt *file = getPrivateData<FileInt>(self);
+
+	if (file->busy)
+		rb_raise(rb_eIOError, "file is being read by another thread");
+
+	return file;
+}
+
+static VALUE
+fileIntReadString(FileInt *file, Sint64 length)
+{
+	if (length > LONG_MAX)
+		rb_raise(rb_eIOError, "File too large to read at once");
+
+	VALUE data = rb_str_new(0, (long) length);
+
+	char *ptr = RSTRING_PTR(data);
+	size_t count = 0;
+
+	file->busy = true;
+	withoutGVL([&]() { count = file->read(ptr, length); });
+	file->busy = false;
+
+	rb_str_set_len(data, count);
+
+	return data;
+}
+
 RB_METHOD(fileIntRead)
 {
 
 	int length = -1;
 	rb_get_args(argc, argv, "i", &length RB_ARG_END);
 
-	SDL_RWops *ops = getPrivateData<SDL_RWops>(self);
+	FileInt *file = getIdleFileInt(self);
+	Sint64 count = length;
 
 	if (length == -1)
 	{
-		Sint64 cur = SDL_RWtell(ops);
-		Sint64 end = SDL_RWseek(ops, 0, SEEK_END);
-		length = end - cur;
-		SDL_RWseek(ops, cur, SEEK_SET);
+		count = file->remaining();
+
+		if (count < 0)
+			rb_raise(rb_eIOError, "Unable to determine file size");
+	}
+	else if (length < 0)
+	{
+		rb_raise(rb_eArgError, "negative length %d given", length);
 	}
 
-	if (length == 0)
+	if (count == 0)
 		return Qnil;
 
-	VALUE data = rb_str_new(0, length);
-
-	SDL_RWread(ops, RSTRING_PTR(data), 1, length);
-
-	return data;
+	return fileIntReadString(file, count);
 }
 
 RB_METHOD(fileIntClose)
 {
 	RB_UNUSED_PARAM;
 
-	SDL_RWops *ops = getPrivateData<SDL_RWops>(self);
-	SDL_RWclose(ops);
+	FileInt *file = getIdleFileInt(self);
+	SDL_RWclose(file->ops);
 
 	return Qnil;
 }
@@ -107,10 +218,10 @@ RB_METHOD(fileIntGetByte)
 {
 	RB_UNUSED_PARAM;
 
-	SDL_RWops *ops = getPrivateData<SDL_RWops>(self);
+	FileInt *file = getIdleFileInt(self);
 
 	unsigned char byte;
-	size_t result = SDL_RWread(ops, &byte, 1, 1);
+	size_t result = file->read(&byte, 1);
 
 	return (result == 1) ? rb_fix_new(byte) : Qnil;
 }
@@ -122,19 +233,164 @@ RB_METHOD(fileIntBinmode)
 	return Qnil;
 }
 
+/* Raw contents of recently loaded data files. Scripts reload the same
+ * few (maps, MapInfos, Tilesets) on every transfer, and are free to
+ * modify what they get back, so only the bytes are kept and parsed
+ * anew each time */
+struct DataCacheEntry
+{
+	std::string path;
+	uint64_t stamp;
+	std::string bytes;
+};
+
+typedef std::list<DataCacheEntry> DataCacheList;
+
+/* Most recently used entries at the front */
+static DataCacheList dataCache;
+static BoostHash<std::string, DataCacheList::iterator> dataCacheIndex;
+static size_t dataCacheBytes = 0;
+
+static void
+dataCacheRemove(DataCacheList::iterator iter)
+{
+	dataCacheBytes -= iter->bytes.size();
+	dataCacheIndex.remove(iter->path);
+	dataCache.erase(iter);
+}
+
+static VALUE
+dataCacheLookup(const char *path, uint64_t stamp)
+{
+	if (!dataCacheIndex.contains(path))
+		return Qnil;
+
+	DataCacheList::iterator iter = dataCacheIndex[path];
+
+	if (iter->stamp != stamp)
+	{
+		dataCacheRemove(iter);
+		return Qnil;
+	}
+
+	dataCache.splice(dataCache.begin(), dataCache, iter);
+
+	return rb_str_new(iter->bytes.c_str(), iter->bytes.size());
+}
+
+static void
+dataCacheInvalidate(const char *path)
+{
+	if (dataCacheIndex.contains(path))
+		dataCacheRemove(dataCacheIndex[path]);
+}
+
+static void
+dataCacheInsert(const char *path, uint64_t stamp, VALUE bytes)
+{
+	size_t budget = (size_t) shState->config().dataCacheSize * 1024 * 1024;
+	size_t size = RSTRING_LEN(bytes);
+
+	if (size > budget)
+		return;
+
+	dataCacheInvalidate(path);
+
+	while (dataCacheBytes + size > budget)
+		dataCacheRemove(--dataCache.end());
+
+	DataCacheEntry entry;
+	entry.path = path;
+	entry.stamp = stamp;
+	dataCache.push_front(entry);
+	dataCache.front().bytes.assign(RSTRING_PTR(bytes), size);
+
+	dataCacheIndex.insert(path, dataCache.begin());
+	dataCacheBytes += size;
+}
+
+VALUE
+marshalLoadData(const char *data, long len);
+
+/* Raises the error of a save that failed in the background */
+static void
+raiseSaveError()
+{
+	int error;
+	VALUE path;
+
+	/* Don't jump over the string's destructor */
+	{
+		std::string filename;
+
+		if (!shState->saveWriter().takeError(error, filename))
+			return;
+
+		path = rb_str_new(filename.c_str(), filename.size());
+	}
+
+	rb_syserr_fail_str(error, path);
+}
+
 VALUE
 kernelLoadDataInt(const char *filename, bool rubyExc)
 {
 	rb_gc_start();
 
-	VALUE port = fileIntForPath(filename, rubyExc);
+	/* Make sure we don't read back a half written save */
+	SaveWriter &writer = shState->saveWriter();
 
-	VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+	if (writer.pending())
+		withoutGVL([&]() { writer.wait(); });
+
+	raiseSaveError();
+
+	uint64_t stamp = 0;
+
+	if (shState->config().dataCacheSize > 0)
+		stamp = shState->fileSystem().fileStamp(filename);
 
-	// FIXME need to catch exceptions here with begin rescue
-	VALUE result = rb_funcall2(marsh, rb_intern("load"), 1, &port);
+	VALUE file = Qnil;
+	VALUE port = Qnil;
 
-	rb_funcall2(port, rb_intern("close"), 0, NULL);
+	if (stamp != 0)
+		port = dataCacheLookup(filename, stamp);
+
+	if (NIL_P(port))
+	{
+		file = fileIntForPath(filename, rubyExc);
+		port = file;
+
+		/* Marshal parses strings a lot faster than any IO */
+		Sint64 size = getPrivateData<FileInt>(file)->remaining();
+
+		if (size >= 0 && size <= LOAD_DATA_MEM_MAX)
+		{
+			port = fileIntReadString(getPrivateData<FileInt>(file), size);
+
+			if (stamp != 0)
+				dataCacheInsert(filename, stamp, port);
+		}
+	}
+
+	VALUE result = Qundef;
+
+	if (RB_TYPE_P(port, T_STRING))
+		result = marshalLoadData(RSTRING_PTR(port), RSTRING_LEN(port));
+
+	/* Not something the native reader understands */
+	if (result == Qundef)
+	{
+		VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+
+		// FIXME need to catch exceptions here with begin rescue
+		result = rb_funcall2(marsh, rb_intern("load"), 1, &port);
+	}
+
+	RB_GC_GUARD(port);
+
+	if (!NIL_P(file))
+		rb_funcall2(file, rb_intern("close"), 0, NULL);
 
 	return result;
 }
@@ -158,18 +414,46 @@ RB_METHOD(kernelSaveData)
 
 	rb_get_args(argc, argv, "oS", &obj, &filename RB_ARG_END);
 
-	VALUE file = rb_file_open_str(filename, "wb");
-
 	VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
 
-	VALUE v[] = { obj, file };
-	rb_funcall2(marsh, rb_intern("dump"), ARRAY_SIZE(v), v);
+	/* Serializing has to happen right away, as the object
+	 * might be modified as soon as we return */
+	VALUE data = rb_funcall2(marsh, rb_intern("dump"), 1, &obj);
+
+	const char *path = StringValueCStr(filename);
 
-	rb_io_close(file);
+	/* The file stamp alone might not tell the contents apart */
+	dataCacheInvalidate(path);
+
+	raiseSaveError();
+
+	int error = shState->saveWriter().write(path, RSTRING_PTR(data), RSTRING_LEN(data));
+
+	if (error)
+		rb_syserr_fail_str(error, filename);
 
 	return Qnil;
 }
 
+RB_METHOD(mkxpSavePending)
+{
+	RB_UNUSED_PARAM;
+
+	return rb_bool_new(shState->saveWriter().pending());
+}
+
+RB_METHOD(mkxpFlushSaves)
+{
+	RB_UNUSED_PARAM;
+
+	SaveWriter &writer = shState->saveWriter();
+	withoutGVL([&]() { writer.wait(); });
+
+	raiseSaveError();
+
+	return Qtrue;
+}
+
 static VALUE stringForceUTF8(VALUE arg)
 {
 	if (RB_TYPE_P(arg, RUBY_T_STRING) && ENCODING_IS_ASCII8BIT(arg))
@@ -220,6 +504,10 @@ fileIntBindingInit()
 	_rb_define_module_function(rb_mKernel, "load_data", kernelLoadData);
 	_rb_define_module_function(rb_mKernel, "save_data", kernelSaveData);
 
+	VALUE mod = rb_define_module("MKXP");
+	_rb_define_module_function(mod, "save_pending?", mkxpSavePending);
+	_rb_define_module_function(mod, "flush_saves", mkxpFlushSaves);
+
 	/* We overload the built-in 'Marshal::load()' function to silently
 	 * insert our utf8proc that ensures all read strings will be
 	 * UTF-8 encoded */
@@ -80,7 +80,7 @@ RB_METHOD(fontInitialize)
 
 	if (NIL_P(namesObj))
 	{
-		namesObj = rb_iv_get(rb_obj_class(self), "default_name");
+		namesObj = rb_ivar_get(rb_obj_class(self), RB_ID("default_name"));
 		f = new Font(0, size);
 	}
 	else
@@ -94,7 +94,7 @@ RB_METHOD(fontInitialize)
 	/* This is semantically wrong; the new Font object should take
 	 * a dup'ed object here in case of an array. Ditto for the setters.
 	 * However the same bug/behavior exists in all RM versions. */
-	rb_iv_set(self, "name", namesObj);
+	rb_ivar_set(self, RB_ID("name"), namesObj);
 
 	setPrivateData(self, f);
 
@@ -136,7 +136,7 @@ RB_METHOD(FontGetName)
 {
 	RB_UNUSED_PARAM;
 
-	return rb_iv_get(self, "name");
+	return rb_ivar_get(self, RB_ID("name"));
 }
 
 RB_METHOD(FontSetName)
@@ -149,7 +149,7 @@ RB_METHOD(FontSetName)
 	collectStrings(argv[0], namesObj);
 
 	f->setName(namesObj);
-	rb_iv_set(self, "name", argv[0]);
+	rb_ivar_set(self, RB_ID("name"), argv[0]);
 
 	return argv[0];
 }
@@ -191,7 +191,7 @@ DEF_KLASS_PROP(Font, bool, DefaultOutline, "b", rb_bool_new)
 RB_METHOD(FontGetDefaultOutColor)
 {
 	RB_UNUSED_PARAM;
-	return rb_iv_get(self, "default_out_color");
+	return rb_ivar_get(self, RB_ID("default_out_color"));
 }
 
 RB_METHOD(FontSetDefaultOutColor)
@@ -212,7 +212,7 @@ RB_METHOD(FontGetDefaultName)
 {
 	RB_UNUSED_PARAM;
 
-	return rb_iv_get(self, "default_name");
+	return rb_ivar_get(self, RB_ID("default_name"));
 }
 
 RB_METHOD(FontSetDefaultName)
@@ -225,7 +225,7 @@ RB_METHOD(FontSetDefaultName)
 	collectStrings(argv[0], namesObj);
 
 	Font::setDefaultName(namesObj, shState->fontState());
-	rb_iv_set(self, "default_name", argv[0]);
+	rb_ivar_set(self, RB_ID("default_name"), argv[0]);
 
 	return argv[0];
 }
@@ -233,7 +233,7 @@ RB_METHOD(FontSetDefaultName)
 RB_METHOD(FontGetDefaultColor)
 {
 	RB_UNUSED_PARAM;
-	return rb_iv_get(self, "default_color");
+	return rb_ivar_get(self, RB_ID("default_color"));
 }
 
 
@@ -282,7 +282,7 @@ fontBindingInit()
 			rb_ary_push(defNamesObj, rb_str_new_cstr(defNames[i].c_str()));
 	}
 
-	rb_iv_set(klass, "default_name", defNamesObj);
+	rb_ivar_set(klass, RB_ID("default_name"), defNamesObj);
 
 	if (rgssVer >= 3)
 		wrapProperty(klass, &Font::getDefaultOutColor(), "default_out_color", ColorType);
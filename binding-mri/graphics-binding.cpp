@@ -25,12 +25,17 @@
 #include "binding-types.h"
 #include "exception.h"
 
+void profilerFrame();
+
 RB_METHOD(graphicsUpdate)
 {
 	RB_UNUSED_PARAM;
 
 	shState->graphics().update();
 
+	reportTexMemory();
+	profilerFrame();
+
 	return Qnil;
 }
 
@@ -159,6 +164,8 @@ RB_METHOD(graphicsSnapToBitmap)
 	VALUE obj = wrapObject(result, BitmapType);
 	bitmapInitProps(result, obj);
 
+	reportTexMemory();
+
 	return obj;
 }
 
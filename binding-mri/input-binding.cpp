@@ -184,7 +184,7 @@ inputBindingInit()
 			rb_hash_aset(symHash, ID2SYM(sym), val);
 		}
 
-		rb_iv_set(module, "buttoncodes", symHash);
+		rb_ivar_set(module, RB_ID("buttoncodes"), symHash);
 		getRbData()->buttoncodeHash = symHash;
 	}
 	else
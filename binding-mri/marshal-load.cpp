@@ -0,0 +1,680 @@
+/*
+** marshal-load.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binding-util.h"
+#include "binding-types.h"
+
+#include "table.h"
+#include "etc.h"
+#include "exception.h"
+
+#include "ruby/encoding.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Marshal reader for data files loaded into memory.
+ *
+ * It understands the subset of the format RGSS data is made of
+ * (plain objects, arrays, hashes, strings, symbols, numbers), and
+ * decodes Table, Color, Tone and Rect straight from the dumped bytes
+ * instead of going through a Ruby string and their '_load'. The
+ * result is the same as that of Marshal.load with the UTF-8 proc
+ * mkxp installs. Anything else makes it give up and return Qundef,
+ * so the caller can hand the data to Marshal.load instead.
+ *
+ * As Marshal.load would then run allocators and Ruby code (hashing
+ * keys, other classes' '_load') once more, the data is read twice:
+ * a first pass only checks that everything in it is understood,
+ * without creating objects, and the second one builds the result */
+
+enum NativeType
+{
+	NativeTable,
+	NativeColor,
+	NativeTone,
+	NativeRect,
+
+	NativeTypeCount
+};
+
+struct MarshalReader
+{
+	const char *ptr;
+	const char *end;
+
+	/* Everything '@' links can refer to, in order of appearance */
+	VALUE objects;
+	/* Everything ';' links can refer to */
+	VALUE symbols;
+
+	/* False while checking the data, in which case nothing
+	 * is created (the tables above hold nil instead) */
+	bool build;
+
+	ID idE;
+};
+
+/* Original '_load' methods, to detect redefinitions */
+static VALUE nativeLoadMethods;
+
+/* The classes whose '_load' we can do natively, or nil if scripts
+ * have replaced it. Recomputed after their singleton methods change */
+static VALUE nativeKlasses[NativeTypeCount];
+static bool nativeKlassesValid;
+
+static const rb_data_type_t *nativeTypes[NativeTypeCount] =
+{
+	&TableType, &ColorType, &ToneType, &RectType
+};
+
+static bool
+readByte(MarshalReader &r, int &byte)
+{
+	if (r.ptr >= r.end)
+		return false;
+
+	byte = (unsigned char) *r.ptr++;
+
+	return true;
+}
+
+static bool
+readLong(MarshalReader &r, long &value)
+{
+	int byte;
+
+	if (!readByte(r, byte))
+		return false;
+
+	int c = (signed char) byte;
+
+	if (c == 0)
+	{
+		value = 0;
+		return true;
+	}
+
+	if (c > 4)
+	{
+		value = c - 5;
+		return true;
+	}
+
+	if (c < -4)
+	{
+		value = c + 5;
+		return true;
+	}
+
+	long x = (c > 0) ? 0 : -1;
+	int len = (c > 0) ? c : -c;
+
+	for (int i = 0; i < len; ++i)
+	{
+		if (!readByte(r, byte))
+			return false;
+
+		x &= ~(0xFFL << (8*i));
+		x |= (long) byte << (8*i);
+	}
+
+	value = x;
+
+	return true;
+}
+
+/* Length prefixed byte sequence, left in place */
+static bool
+readBytes(MarshalReader &r, const char *&data, long &len)
+{
+	if (!readLong(r, len) || len < 0 || len > r.end - r.ptr)
+		return false;
+
+	data = r.ptr;
+	r.ptr += len;
+
+	return true;
+}
+
+/* A count of elements that each take at least one byte */
+static bool
+readCount(MarshalReader &r, long &count)
+{
+	return readLong(r, count) && count >= 0 && count <= r.end - r.ptr;
+}
+
+static VALUE readObject(MarshalReader &r);
+
+static VALUE
+readSymbol(MarshalReader &r)
+{
+	int type;
+
+	if (!readByte(r, type))
+		return Qundef;
+
+	if (type == ';')
+	{
+		long idx;
+
+		if (!readLong(r, idx) || idx < 0 || idx >= RARRAY_LEN(r.symbols))
+			return Qundef;
+
+		return rb_ary_entry(r.symbols, idx);
+	}
+
+	bool ivar = (type == 'I');
+
+	if (ivar && !readByte(r, type))
+		return Qundef;
+
+	if (type != ':')
+		return Qundef;
+
+	const char *data;
+	long len;
+
+	if (!readBytes(r, data, len))
+		return Qundef;
+
+	/* Symbols seen while reading the ivars come after this one */
+	long idx = RARRAY_LEN(r.symbols);
+	rb_ary_push(r.symbols, Qnil);
+
+	rb_encoding *enc = rb_ascii8bit_encoding();
+
+	if (ivar)
+	{
+		long count;
+
+		if (!readCount(r, count))
+			return Qundef;
+
+		for (long i = 0; i < count; ++i)
+		{
+			VALUE name = readSymbol(r);
+
+			if (name == Qundef || SYM2ID(name) != r.idE)
+				return Qundef;
+
+			VALUE utf8 = readObject(r);
+
+			if (utf8 == Qundef)
+				return Qundef;
+
+			if (RTEST(utf8))
+				enc = rb_utf8_encoding();
+		}
+	}
+
+	VALUE sym = ID2SYM(rb_intern3(data, len, enc));
+	rb_ary_store(r.symbols, idx, sym);
+
+	return sym;
+}
+
+static VALUE
+registerObject(MarshalReader &r, VALUE obj)
+{
+	rb_ary_push(r.objects, obj);
+
+	return obj;
+}
+
+/* Reads the ivars following an 'I' prefixed string, which may only
+ * carry its encoding ('E'). Anything more exotic is left to Ruby */
+static bool
+readStringEncoding(MarshalReader &r, VALUE str)
+{
+	long count;
+
+	if (!readCount(r, count))
+		return false;
+
+	for (long i = 0; i < count; ++i)
+	{
+		VALUE name = readSymbol(r);
+
+		if (name == Qundef || SYM2ID(name) != r.idE)
+			return false;
+
+		VALUE utf8 = readObject(r);
+
+		if (utf8 == Qundef)
+			return false;
+
+		if (r.build)
+			rb_enc_associate(str, RTEST(utf8) ? rb_utf8_encoding()
+			                                  : rb_usascii_encoding());
+	}
+
+	return true;
+}
+
+static VALUE
+readString(MarshalReader &r, bool ivar)
+{
+	const char *data;
+	long len;
+
+	if (!readBytes(r, data, len))
+		return Qundef;
+
+	/* Strings without an encoding come out as UTF-8, as
+	 * with the proc our Marshal.load passes along */
+	VALUE str = Qnil;
+
+	if (r.build)
+		str = rb_enc_str_new(data, len, rb_utf8_encoding());
+
+	registerObject(r, str);
+
+	if (ivar && !readStringEncoding(r, str))
+		return Qundef;
+
+	return r.build ? str : Qtrue;
+}
+
+static VALUE
+readFloat(MarshalReader &r)
+{
+	const char *data;
+	long len;
+
+	if (!readBytes(r, data, len) || len == 0 || len > 64)
+		return Qundef;
+
+	char buf[65];
+	memcpy(buf, data, len);
+	buf[len] = '\0';
+
+	double d;
+
+	if (strcmp(buf, "nan") == 0)
+	{
+		d = NAN;
+	}
+	else if (strcmp(buf, "inf") == 0)
+	{
+		d = HUGE_VAL;
+	}
+	else if (strcmp(buf, "-inf") == 0)
+	{
+		d = -HUGE_VAL;
+	}
+	else
+	{
+		/* Old dumps may append mantissa bytes, leave those to Ruby */
+		char *e;
+		d = strtod(buf, &e);
+
+		if (e != buf + len)
+			return Qundef;
+	}
+
+	if (!r.build)
+		return registerObject(r, Qnil);
+
+	return registerObject(r, DBL2NUM(d));
+}
+
+static VALUE
+readClass(MarshalReader &r)
+{
+	VALUE name = readSymbol(r);
+
+	if (name == Qundef)
+		return Qundef;
+
+	return rb_path_to_class(rb_sym_to_s(name));
+}
+
+static VALUE
+readUserDef(MarshalReader &r, bool ivar)
+{
+	VALUE klass = readClass(r);
+
+	if (klass == Qundef)
+		return Qundef;
+
+	const char *data;
+	long len;
+
+	if (!readBytes(r, data, len))
+		return Qundef;
+
+	/* Our dumps never carry ivars, and other classes' (or
+	 * replaced) '_load' methods are left to Marshal.load */
+	int i;
+
+	for (i = 0; i < NativeTypeCount; ++i)
+		if (klass == nativeKlasses[i])
+			break;
+
+	if (i == NativeTypeCount || ivar)
+		return Qundef;
+
+	if (!r.build)
+	{
+		registerObject(r, Qnil);
+		return Qtrue;
+	}
+
+	VALUE obj = rb_obj_alloc(klass);
+	void *c = 0;
+
+	switch (i)
+	{
+	case NativeTable :
+		GUARD_EXC( c = Table::deserialize(data, len); );
+		break;
+	case NativeColor :
+		GUARD_EXC( c = Color::deserialize(data, len); );
+		break;
+	case NativeTone :
+		GUARD_EXC( c = Tone::deserialize(data, len); );
+		break;
+	case NativeRect :
+		GUARD_EXC( c = Rect::deserialize(data, len); );
+		break;
+	}
+
+	setPrivateData(obj, c);
+
+	return registerObject(r, obj);
+}
+
+static VALUE
+readPlainObject(MarshalReader &r)
+{
+	VALUE klass = readClass(r);
+
+	/* Only classes allocating plain objects */
+	if (klass == Qundef || !RB_TYPE_P(klass, T_CLASS)
+	    || rb_get_alloc_func(klass) != rb_get_alloc_func(rb_cObject))
+		return Qundef;
+
+	VALUE obj = r.build ? rb_obj_alloc(klass) : Qtrue;
+
+	registerObject(r, r.build ? obj : Qnil);
+
+	long count;
+
+	if (!readCount(r, count))
+		return Qundef;
+
+	for (long i = 0; i < count; ++i)
+	{
+		VALUE name = readSymbol(r);
+
+		if (name == Qundef)
+			return Qundef;
+
+		VALUE value = readObject(r);
+
+		if (value == Qundef)
+			return Qundef;
+
+		if (r.build)
+			rb_ivar_set(obj, SYM2ID(name), value);
+	}
+
+	return obj;
+}
+
+static VALUE
+readArray(MarshalReader &r)
+{
+	long len;
+
+	if (!readCount(r, len))
+		return Qundef;
+
+	VALUE ary = registerObject(r, r.build ? rb_ary_new2(len) : Qnil);
+
+	for (long i = 0; i < len; ++i)
+	{
+		VALUE value = readObject(r);
+
+		if (value == Qundef)
+			return Qundef;
+
+		if (r.build)
+			rb_ary_push(ary, value);
+	}
+
+	return r.build ? ary : Qtrue;
+}
+
+static VALUE
+readHash(MarshalReader &r, bool withDefault)
+{
+	long len;
+
+	if (!readCount(r, len))
+		return Qundef;
+
+	VALUE hash = registerObject(r, r.build ? rb_hash_new() : Qnil);
+
+	for (long i = 0; i < len; ++i)
+	{
+		VALUE key = readObject(r);
+
+		if (key == Qundef)
+			return Qundef;
+
+		VALUE value = readObject(r);
+
+		if (value == Qundef)
+			return Qundef;
+
+		if (r.build)
+			rb_hash_aset(hash, key, value);
+	}
+
+	if (withDefault)
+	{
+		VALUE def = readObject(r);
+
+		if (def == Qundef)
+			return Qundef;
+
+		if (r.build)
+			rb_hash_set_ifnone(hash, def);
+	}
+
+	return r.build ? hash : Qtrue;
+}
+
+static VALUE
+readObject(MarshalReader &r)
+{
+	int type;
+
+	if (!readByte(r, type))
+		return Qundef;
+
+	bool ivar = (type == 'I');
+
+	if (ivar)
+	{
+		if (!readByte(r, type))
+			return Qundef;
+
+		/* readSymbol() handles the prefix itself */
+		if (type == ':')
+		{
+			r.ptr -= 2;
+			return readSymbol(r);
+		}
+
+		/* Only strings and user dumps carry their
+		 * encoding like this in RGSS data */
+		if (type != '"' && type != 'u')
+			return Qundef;
+	}
+
+	switch (type)
+	{
+	case '0' :
+		return Qnil;
+	case 'T' :
+		return Qtrue;
+	case 'F' :
+		return Qfalse;
+
+	case 'i' :
+	{
+		long value;
+
+		if (!readLong(r, value))
+			return Qundef;
+
+		return LONG2NUM(value);
+	}
+
+	case ':' :
+	case ';' :
+		/* Let readSymbol() see the type again */
+		--r.ptr;
+		return readSymbol(r);
+
+	case '@' :
+	{
+		long idx;
+
+		if (!readLong(r, idx) || idx < 0 || idx >= RARRAY_LEN(r.objects))
+			return Qundef;
+
+		if (!r.build)
+			return Qtrue;
+
+		return rb_ary_entry(r.objects, idx);
+	}
+
+	case '"' :
+		return readString(r, ivar);
+	case 'f' :
+		return readFloat(r);
+	case '[' :
+		return readArray(r);
+	case '{' :
+		return readHash(r, false);
+	case '}' :
+		return readHash(r, true);
+	case 'o' :
+		return readPlainObject(r);
+	case 'u' :
+		return readUserDef(r, ivar);
+
+	default :
+		return Qundef;
+	}
+}
+
+static void
+updateNativeKlasses()
+{
+	for (int i = 0; i < NativeTypeCount; ++i)
+	{
+		VALUE klass = rb_const_get(rb_cObject, rb_intern(nativeTypes[i]->wrap_struct_name));
+		VALUE method = rb_obj_method(klass, ID2SYM(RB_ID("_load")));
+
+		nativeKlasses[i] = rb_equal(method, rb_ary_entry(nativeLoadMethods, i)) ? klass : Qnil;
+	}
+
+	nativeKlassesValid = true;
+}
+
+static VALUE
+readData(MarshalReader &r, const char *data, long len, bool build)
+{
+	r.ptr = data;
+	r.end = data + len;
+	r.build = build;
+
+	int major, minor;
+
+	if (!readByte(r, major) || !readByte(r, minor) || major != 4 || minor != 8)
+		return Qundef;
+
+	rb_ary_clear(r.objects);
+	rb_ary_clear(r.symbols);
+
+	return readObject(r);
+}
+
+VALUE
+marshalLoadData(const char *data, long len)
+{
+	if (!nativeKlassesValid)
+		updateNativeKlasses();
+
+	MarshalReader r;
+	r.objects = rb_ary_new();
+	r.symbols = rb_ary_new();
+	r.idE = rb_intern("E");
+
+	VALUE result = readData(r, data, len, false);
+
+	if (result != Qundef)
+		result = readData(r, data, len, true);
+
+	RB_GC_GUARD(r.objects);
+	RB_GC_GUARD(r.symbols);
+
+	return result;
+}
+
+/* Prepended to the native classes' singleton classes, so even
+ * hooks defined by scripts can't keep these from being called */
+RB_METHOD(nativeLoadHook)
+{
+	RB_UNUSED_PARAM;
+
+	nativeKlassesValid = false;
+
+	return rb_call_super(argc, argv);
+}
+
+void
+marshalLoadBindingInit()
+{
+	nativeLoadMethods = rb_ary_new();
+	rb_gc_register_address(&nativeLoadMethods);
+
+	/* Kept alive by the classes it is prepended to */
+	VALUE hooks = rb_module_new();
+
+	_rb_define_method(hooks, "singleton_method_added", nativeLoadHook);
+	_rb_define_method(hooks, "singleton_method_removed", nativeLoadHook);
+	_rb_define_method(hooks, "singleton_method_undefined", nativeLoadHook);
+
+	for (int i = 0; i < NativeTypeCount; ++i)
+	{
+		VALUE klass = rb_const_get(rb_cObject, rb_intern(nativeTypes[i]->wrap_struct_name));
+		rb_ary_push(nativeLoadMethods, rb_obj_method(klass, ID2SYM(rb_intern("_load"))));
+
+		rb_prepend_module(rb_singleton_class(klass), hooks);
+	}
+}
@@ -0,0 +1,240 @@
+/*
+** pathfinder-binding.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binding-util.h"
+#include "binding-types.h"
+
+#include "pathfinder.h"
+#include "sharedstate.h"
+#include "table.h"
+
+#include <algorithm>
+
+/* Whether the tile stack at (x, y) can be left in direction 'bit',
+ * mirroring Game_Map#passable? of the RMXP default scripts */
+static bool
+tilePassable(const Table &mapData, const Table &passages,
+             const Table &priorities, int x, int y, int bit)
+{
+	for (int i = std::min(mapData.zSize(), 3) - 1; i >= 0; --i)
+	{
+		int tileId = mapData.at(x, y, i);
+
+		if (tileId < 0 || tileId >= passages.xSize())
+			return false;
+
+		int passage = passages.at(tileId);
+
+		if (passage & bit)
+			return false;
+
+		if ((passage & 0x0F) == 0x0F)
+			return false;
+
+		if (tileId < priorities.xSize() && priorities.at(tileId) == 0)
+			return true;
+	}
+
+	return true;
+}
+
+/* passability(map_data, passages, priorities)
+ * Builds a grid for find() from RMXP map and tileset data */
+RB_METHOD(pathfinderPassability)
+{
+	RB_UNUSED_PARAM;
+
+	VALUE mapObj, passagesObj, prioritiesObj;
+	rb_get_args_fixed(argc, argv, &mapObj, &passagesObj, &prioritiesObj);
+
+	Table *mapData = getPrivateDataCheck<Table>(mapObj, TableType);
+	Table *passages = getPrivateDataCheck<Table>(passagesObj, TableType);
+	Table *priorities = getPrivateDataCheck<Table>(prioritiesObj, TableType);
+
+	int width = mapData->xSize();
+	int height = mapData->ySize();
+
+	Table *grid = new Table(width, height, 2);
+
+	static const int bits[] =
+	{
+		Pathfinder::BlockedDown, Pathfinder::BlockedLeft,
+		Pathfinder::BlockedRight, Pathfinder::BlockedUp
+	};
+
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+		{
+			int blocked = 0;
+
+			for (size_t i = 0; i < ARRAY_SIZE(bits); ++i)
+				if (!tilePassable(*mapData, *passages, *priorities, x, y, bits[i]))
+					blocked |= bits[i];
+
+			grid->at(x, y, 0) = 1;
+			grid->at(x, y, 1) = blocked;
+		}
+
+	return wrapObject(grid, TableType);
+}
+
+/* Arguments shared by find() and find_async():
+ * (grid, start_x, start_y, target_x, target_y [, diagonal [, cost_layer]]) */
+static void
+parseQuery(int argc, VALUE *argv, Pathfinder::Query &query)
+{
+	VALUE gridObj, costObj = Qnil;
+	int sx, sy, tx, ty;
+	bool diagonal = false;
+
+	rb_get_args(argc, argv, "oiiii|bo", &gridObj, &sx, &sy, &tx, &ty,
+	            &diagonal, &costObj RB_ARG_END);
+
+	Table *grid = getPrivateDataCheck<Table>(gridObj, TableType);
+	Table *costs = 0;
+
+	if (!NIL_P(costObj))
+		costs = getPrivateDataCheck<Table>(costObj, TableType);
+
+	int width = grid->xSize();
+	int height = grid->ySize();
+
+	if (costs && (costs->xSize() != width || costs->ySize() != height))
+		rb_raise(rb_eArgError, "Cost layer size differs from grid");
+
+	Pathfinder::Grid &g = query.grid;
+	g.width = width;
+	g.height = height;
+	g.costs.resize((size_t) width * height);
+
+	if (grid->zSize() > 1)
+		g.blocked.resize(g.costs.size());
+
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+		{
+			size_t i = (size_t) y * width + x;
+			int cost = grid->at(x, y, 0);
+
+			if (costs && cost > 0)
+			{
+				int extra = costs->at(x, y, 0);
+				cost = extra < 0 ? 0 : cost + extra;
+			}
+
+			g.costs[i] = cost;
+
+			if (!g.blocked.empty())
+				g.blocked[i] = grid->at(x, y, 1);
+		}
+
+	query.start = Vec2i(sx, sy);
+	query.target = Vec2i(tx, ty);
+	query.diagonal = diagonal;
+}
+
+static VALUE
+pathToArray(const Pathfinder::Path &path)
+{
+	VALUE ary = rb_ary_new2(path.size());
+
+	for (size_t i = 0; i < path.size(); ++i)
+		rb_ary_push(ary, rb_assoc_new(INT2FIX(path[i].x), INT2FIX(path[i].y)));
+
+	return ary;
+}
+
+/* Returns the cells to walk through as [x, y] pairs,
+ * or nil if the target can't be reached */
+RB_METHOD(pathfinderFind)
+{
+	RB_UNUSED_PARAM;
+
+	Pathfinder::Query query;
+	parseQuery(argc, argv, query);
+
+	Pathfinder::Path path;
+
+	if (!Pathfinder::find(query, path))
+		return Qnil;
+
+	return pathToArray(path);
+}
+
+/* Same as find(), but searches on a background thread.
+ * Returns an id to poll() the result with */
+RB_METHOD(pathfinderFindAsync)
+{
+	RB_UNUSED_PARAM;
+
+	Pathfinder::Query query;
+	parseQuery(argc, argv, query);
+
+	return INT2NUM(shState->pathfinder().request(query));
+}
+
+/* Returns nil while the search is running, then (once)
+ * the path, or false if the target can't be reached */
+RB_METHOD(pathfinderPoll)
+{
+	RB_UNUSED_PARAM;
+
+	int id;
+	rb_get_args_fixed(argc, argv, &id);
+
+	Pathfinder::Path path;
+
+	switch (shState->pathfinder().poll(id, path))
+	{
+	case Pathfinder::Pending :
+		return Qnil;
+	case Pathfinder::Found :
+		return pathToArray(path);
+	case Pathfinder::NotFound :
+		return Qfalse;
+	default:
+		rb_raise(rb_eArgError, "Unknown pathfinder request %d", id);
+	}
+}
+
+/* Drops a find_async request that is no longer of interest.
+ * Returns false if it was unknown (or already polled) */
+RB_METHOD(pathfinderCancel)
+{
+	RB_UNUSED_PARAM;
+
+	int id;
+	rb_get_args_fixed(argc, argv, &id);
+
+	return rb_bool_new(shState->pathfinder().cancel(id));
+}
+
+void
+pathfinderBindingInit()
+{
+	VALUE mod = rb_define_module_under(rb_define_module("MKXP"), "Pathfinder");
+
+	_rb_define_module_function(mod, "passability", pathfinderPassability);
+	_rb_define_module_function(mod, "find", pathfinderFind);
+	_rb_define_module_function(mod, "find_async", pathfinderFindAsync);
+	_rb_define_module_function(mod, "poll", pathfinderPoll);
+	_rb_define_module_function(mod, "cancel", pathfinderCancel);
+}
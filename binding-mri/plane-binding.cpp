@@ -45,6 +45,9 @@ DEF_PROP_OBJ_REF(Plane, Bitmap, Bitmap, "bitmap")
 DEF_PROP_OBJ_VAL(Plane, Color,  Color,  "color")
 DEF_PROP_OBJ_VAL(Plane, Tone,   Tone,   "tone")
 
+DEF_PROP_OBJ_SET(Plane, Color, double, 3, 255)
+DEF_PROP_OBJ_SET(Plane, Tone,  double, 3, 0)
+
 DEF_PROP_I(Plane, OX)
 DEF_PROP_I(Plane, OY)
 DEF_PROP_I(Plane, Opacity)
@@ -74,4 +77,7 @@ planeBindingInit()
 	INIT_PROP_BIND( Plane, BlendType, "blend_type" );
 	INIT_PROP_BIND( Plane, Color,     "color"      );
 	INIT_PROP_BIND( Plane, Tone,      "tone"       );
+
+	INIT_PROP_SET_BIND( Plane, Color, "color" );
+	INIT_PROP_SET_BIND( Plane, Tone,  "tone"  );
 }
@@ -0,0 +1,478 @@
+/*
+** profiler-binding.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binding-util.h"
+
+#include "sharedstate.h"
+#include "eventthread.h"
+#include "config.h"
+#include "boost-hash.h"
+#include "debugwriter.h"
+
+#include <ruby/debug.h>
+#include <SDL_timer.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <time.h>
+
+/* Sampling profiler for the game scripts.
+ *
+ * A timer thread periodically requests a postponed job, which
+ * the Ruby thread runs at its next safe point to record its
+ * current stack. Frames are attributed to the script section
+ * they were defined in. While stopped, nothing is sampled */
+
+/* Stacks deeper than this are cut off at the bottom */
+#define MAX_DEPTH 128
+#define SAMPLE_INTERVAL_MS 1
+
+/* The timer thread can only request the sampling job if the API
+ * allows calling in from foreign threads. Before 3.0, the current
+ * thread was a plain global (so this worked the same as from signal
+ * handlers), 3.3 added rb_postponed_job_trigger() for it.
+ * rb_profile_frames() itself only exists since 2.1 */
+#if RUBY_API_VERSION_MAJOR == 2 && RUBY_API_VERSION_MINOR >= 1
+#  define PROFILER_SUPPORTED
+#elif RUBY_API_VERSION_MAJOR > 3 || (RUBY_API_VERSION_MAJOR == 3 && RUBY_API_VERSION_MINOR >= 3)
+#  define PROFILER_SUPPORTED
+#  define PROFILER_JOB_TRIGGER
+#endif
+
+struct FrameInfo
+{
+	/* "label (section)" */
+	std::string name;
+	/* Empty for code outside of the game scripts */
+	std::string section;
+};
+
+/* Samples keyed by the frame ids of the stack (outermost first),
+ * followed by the line in the innermost frame */
+typedef BoostHash<std::vector<int>, unsigned long> StackHash;
+/* Samples keyed by section name */
+typedef BoostHash<std::string, unsigned long> SectionHash;
+
+struct Profiler
+{
+	bool running;
+	SDL_TimerID timer;
+
+#ifdef PROFILER_JOB_TRIGGER
+	rb_postponed_job_handle_t job;
+#endif
+
+	/* Maps: Ruby visible filename, To: script section name */
+	BoostHash<std::string, std::string> scriptNames;
+
+	/* Frames are identified by their object, which are kept
+	 * alive in 'frameObjs' so their ids can't be reused */
+	BoostHash<VALUE, int> frameIds;
+	std::vector<FrameInfo> frames;
+	VALUE frameObjs;
+
+	StackHash stacks;
+	/* Keyed by "section:line" of the innermost script frame */
+	SectionHash lines;
+	SectionHash sections;
+
+	/* Samples of the frame currently being rendered */
+	SectionHash frameSections;
+	unsigned long frameSamples;
+
+	/* The last completed frame */
+	SectionHash lastFrame;
+	/* The completed frame with the most samples */
+	SectionHash busiestFrame;
+
+	unsigned long samples;
+	unsigned long frameCount;
+	unsigned long maxFrameSamples;
+};
+
+static Profiler profiler;
+
+#ifdef PROFILER_SUPPORTED
+static int
+frameId(VALUE frame)
+{
+	BoostHash<VALUE, int>::const_iterator iter = profiler.frameIds.find(frame);
+
+	if (iter != profiler.frameIds.cend())
+		return iter->second;
+
+	VALUE label = rb_profile_frame_full_label(frame);
+	VALUE path = rb_profile_frame_path(frame);
+
+	std::string file;
+
+	if (!NIL_P(path))
+		file.assign(RSTRING_PTR(path), RSTRING_LEN(path));
+
+	FrameInfo info;
+	info.section = profiler.scriptNames.value(file, std::string());
+
+	if (!NIL_P(label))
+		info.name.assign(RSTRING_PTR(label), RSTRING_LEN(label));
+
+	info.name += " (" + (info.section.empty() ? file : info.section) + ")";
+
+	/* ';' separates frames in the folded output */
+	std::replace(info.name.begin(), info.name.end(), ';', ',');
+
+	int id = profiler.frames.size();
+
+	profiler.frames.push_back(info);
+	profiler.frameIds.insert(frame, id);
+	rb_ary_push(profiler.frameObjs, frame);
+
+	return id;
+}
+
+static void
+sampleJob(void *)
+{
+	if (!profiler.running)
+		return;
+
+	VALUE buff[MAX_DEPTH];
+	int lines[MAX_DEPTH];
+
+	int count = rb_profile_frames(0, MAX_DEPTH, buff, lines);
+
+	if (count <= 0)
+		return;
+
+	std::vector<int> stack(count + 1);
+	int scriptFrame = -1;
+
+	for (int i = 0; i < count; ++i)
+	{
+		int id = frameId(buff[i]);
+		stack[count-1-i] = id;
+
+		if (scriptFrame < 0 && !profiler.frames[id].section.empty())
+			scriptFrame = i;
+	}
+
+	stack[count] = lines[0];
+	++profiler.stacks[stack];
+
+	std::string section = "(other)";
+
+	if (scriptFrame >= 0)
+	{
+		section = profiler.frames[stack[count-1-scriptFrame]].section;
+
+		char line[16];
+		snprintf(line, sizeof(line), ":%d", lines[scriptFrame]);
+		++profiler.lines[section + line];
+	}
+
+	++profiler.sections[section];
+	++profiler.frameSections[section];
+
+	++profiler.samples;
+	++profiler.frameSamples;
+}
+#endif
+
+static Uint32
+timerCallback(Uint32 interval, void *)
+{
+#ifdef PROFILER_JOB_TRIGGER
+	rb_postponed_job_trigger(profiler.job);
+#elif defined(PROFILER_SUPPORTED)
+	rb_postponed_job_register_one(0, sampleJob, 0);
+#endif
+
+	return interval;
+}
+
+static void
+profilerStart()
+{
+	if (profiler.running)
+		return;
+
+#ifndef PROFILER_SUPPORTED
+	Debug() << "Script profiler: not supported with this Ruby version";
+	return;
+#endif
+
+	profiler.stacks.clear();
+	profiler.lines.clear();
+	profiler.sections.clear();
+	profiler.frameSections.clear();
+	profiler.lastFrame.clear();
+	profiler.busiestFrame.clear();
+
+	profiler.samples = 0;
+	profiler.frameSamples = 0;
+	profiler.frameCount = 0;
+	profiler.maxFrameSamples = 0;
+
+	profiler.timer = SDL_AddTimer(SAMPLE_INTERVAL_MS, timerCallback, 0);
+
+	if (!profiler.timer)
+	{
+		Debug() << "Script profiler: failed to start timer:" << SDL_GetError();
+		return;
+	}
+
+	profiler.running = true;
+
+	Debug() << "Script profiler started";
+}
+
+static void
+profilerStop()
+{
+	if (!profiler.running)
+		return;
+
+	SDL_RemoveTimer(profiler.timer);
+
+	/* A job that was already requested returns right away */
+	profiler.running = false;
+
+	Debug() << "Script profiler stopped," << profiler.samples << "samples";
+}
+
+/* Writes the samples in the folded stack format used by
+ * flamegraph tools, one line per distinct stack */
+static bool
+writeFolded(const std::string &path)
+{
+	FILE *f = fopen(path.c_str(), "w");
+
+	if (!f)
+		return false;
+
+	std::string line;
+
+	for (StackHash::const_iterator iter = profiler.stacks.cbegin();
+	     iter != profiler.stacks.cend(); ++iter)
+	{
+		const std::vector<int> &stack = iter->first;
+		const size_t depth = stack.size() - 1;
+
+		line.clear();
+
+		for (size_t i = 0; i < depth; ++i)
+		{
+			if (i > 0)
+				line += ';';
+
+			line += profiler.frames[stack[i]].name;
+		}
+
+		fprintf(f, "%s:%d %lu\n", line.c_str(), stack[depth], iter->second);
+	}
+
+	return fclose(f) == 0;
+}
+
+static std::string
+defaultPath()
+{
+	const Config &conf = shState->config();
+	const std::string &dataPath = conf.customDataPath.empty()
+	        ? conf.commonDataPath : conf.customDataPath;
+
+	char name[64];
+	time_t now = time(0);
+	strftime(name, sizeof(name), "profile-%Y%m%d-%H%M%S.folded", localtime(&now));
+
+	return dataPath + name;
+}
+
+static void
+dumpDefault()
+{
+	std::string path = defaultPath();
+
+	if (writeFolded(path))
+		Debug() << "Script profile written to" << path;
+	else
+		Debug() << "Script profiler: failed to write" << path;
+}
+
+void
+profilerAddScriptName(const char *filename, const char *scriptName)
+{
+	profiler.scriptNames.insert(filename, scriptName);
+}
+
+/* Called once per Graphics.update */
+void
+profilerFrame()
+{
+	RGSSThreadData &rtData = shState->rtData();
+
+	if (rtData.rqProfilerToggle)
+	{
+		rtData.rqProfilerToggle.clear();
+
+		if (profiler.running)
+		{
+			profilerStop();
+			dumpDefault();
+		}
+		else
+		{
+			profilerStart();
+		}
+	}
+
+	if (!profiler.running)
+		return;
+
+	++profiler.frameCount;
+
+	if (profiler.frameSamples > profiler.maxFrameSamples)
+	{
+		profiler.maxFrameSamples = profiler.frameSamples;
+		profiler.busiestFrame = profiler.frameSections;
+	}
+
+	profiler.lastFrame = profiler.frameSections;
+	profiler.frameSections.clear();
+	profiler.frameSamples = 0;
+}
+
+void
+profilerShutdown()
+{
+	if (!profiler.running)
+		return;
+
+	profilerStop();
+	dumpDefault();
+}
+
+RB_METHOD(profilerStartM)
+{
+	RB_UNUSED_PARAM;
+
+	profilerStart();
+
+	return rb_bool_new(profiler.running);
+}
+
+RB_METHOD(profilerStopM)
+{
+	RB_UNUSED_PARAM;
+
+	profilerStop();
+
+	return Qnil;
+}
+
+RB_METHOD(profilerIsRunning)
+{
+	RB_UNUSED_PARAM;
+
+	return rb_bool_new(profiler.running);
+}
+
+/* dump([path]) writes the folded stacks, by default into
+ * the data directory. Returns the path written to */
+RB_METHOD(profilerDump)
+{
+	RB_UNUSED_PARAM;
+
+	const char *path = 0;
+	rb_get_args(argc, argv, "|z", &path RB_ARG_END);
+
+	std::string target = path ? std::string(path) : defaultPath();
+
+	if (!writeFolded(target))
+		rb_raise(rb_eIOError, "Failed to write profile to '%s'", target.c_str());
+
+	return rb_str_new(target.c_str(), target.size());
+}
+
+static VALUE
+sectionHashValue(const SectionHash &samples)
+{
+	VALUE hash = rb_hash_new();
+
+	for (SectionHash::const_iterator iter = samples.cbegin();
+	     iter != samples.cend(); ++iter)
+		rb_hash_aset(hash, rb_str_new(iter->first.c_str(), iter->first.size()),
+		             ULONG2NUM(iter->second));
+
+	return hash;
+}
+
+static void
+statSet(VALUE hash, const char *name, VALUE value)
+{
+	rb_hash_aset(hash, ID2SYM(rb_intern(name)), value);
+}
+
+RB_METHOD(profilerStats)
+{
+	RB_UNUSED_PARAM;
+
+	VALUE hash = rb_hash_new();
+
+	statSet(hash, "samples",           ULONG2NUM(profiler.samples));
+	statSet(hash, "frames",            ULONG2NUM(profiler.frameCount));
+	statSet(hash, "interval",          INT2FIX(SAMPLE_INTERVAL_MS));
+	statSet(hash, "max_frame_samples", ULONG2NUM(profiler.maxFrameSamples));
+	statSet(hash, "busiest_frame",     sectionHashValue(profiler.busiestFrame));
+	statSet(hash, "sections",          sectionHashValue(profiler.sections));
+	statSet(hash, "last_frame",        sectionHashValue(profiler.lastFrame));
+	statSet(hash, "lines",             sectionHashValue(profiler.lines));
+
+	return hash;
+}
+
+void
+profilerBindingInit()
+{
+	profiler.running = false;
+	profiler.timer = 0;
+	profiler.samples = profiler.frameSamples = 0;
+	profiler.frameCount = profiler.maxFrameSamples = 0;
+
+	profiler.frameObjs = rb_ary_new();
+	rb_gc_register_address(&profiler.frameObjs);
+
+#ifdef PROFILER_JOB_TRIGGER
+	profiler.job = rb_postponed_job_preregister(0, sampleJob, 0);
+#endif
+
+	VALUE mod = rb_define_module_under(rb_define_module("MKXP"), "Profiler");
+
+	_rb_define_module_function(mod, "start", profilerStartM);
+	_rb_define_module_function(mod, "stop", profilerStopM);
+	_rb_define_module_function(mod, "running?", profilerIsRunning);
+	_rb_define_module_function(mod, "dump", profilerDump);
+	_rb_define_module_function(mod, "stats", profilerStats);
+
+	if (shState->config().profileScripts)
+		profilerStart();
+}
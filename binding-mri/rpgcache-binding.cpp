@@ -0,0 +1,409 @@
+/*
+** rpgcache-binding.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binding-util.h"
+
+#include "bitmap.h"
+#include "boost-hash.h"
+#include "sharedstate.h"
+#include "config.h"
+
+#include <list>
+#include <string>
+#include <stdio.h>
+
+/* Native implementation of RGSS1's RPG::Cache.
+ *
+ * Bitmaps are kept in least recently used order. Once their
+ * combined size exceeds the configured budget, the oldest ones
+ * are dropped from the cache. They are not disposed, as scripts
+ * might still hold on to them; dropping our reference merely lets
+ * the GC reclaim them as soon as nobody else does. Until then,
+ * they are only weakly referenced, and are handed out (and taken
+ * back in) again instead of loading a duplicate */
+
+struct CacheEntry
+{
+	std::string key;
+	size_t bytes;
+};
+
+typedef std::list<CacheEntry> EntryList;
+
+struct RPGCache
+{
+	/* Keeps the bitmap objects alive, keyed like 'index' */
+	VALUE bitmaps;
+
+	/* ObjectSpace::WeakMap of evicted bitmaps. It compares keys
+	 * by identity, so each key string is interned in 'keyObjs' */
+	VALUE evicted;
+	VALUE keyObjs;
+
+	/* Most recently used entries at the front */
+	EntryList lru;
+	BoostHash<std::string, EntryList::iterator> index;
+
+	size_t bytes;
+	size_t budget;
+
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned long revivals;
+};
+
+static RPGCache cache;
+
+static VALUE
+keyString(const std::string &key)
+{
+	return rb_str_new(key.c_str(), key.size());
+}
+
+static VALUE
+newWeakMap()
+{
+	VALUE objSpace = rb_const_get(rb_cObject, rb_intern("ObjectSpace"));
+	VALUE klass = rb_const_get(objSpace, rb_intern("WeakMap"));
+
+	return rb_class_new_instance(0, 0, klass);
+}
+
+static VALUE
+keyObject(const std::string &key)
+{
+	VALUE str = keyString(key);
+	VALUE obj = rb_hash_lookup(cache.keyObjs, str);
+
+	/* WeakMap keys can't be frozen, so the stored object
+	 * is a separate copy of the (frozen) hash key */
+	if (NIL_P(obj))
+	{
+		obj = rb_str_dup(str);
+		rb_hash_aset(cache.keyObjs, str, obj);
+	}
+
+	return obj;
+}
+
+static void
+cacheRemove(const std::string &key)
+{
+	EntryList::iterator iter = cache.index[key];
+
+	cache.bytes -= iter->bytes;
+	rb_hash_delete(cache.bitmaps, keyString(key));
+
+	/* 'key' might refer to the entry itself */
+	cache.index.remove(key);
+	cache.lru.erase(iter);
+}
+
+static void
+cacheEvict(const std::string &key)
+{
+	VALUE obj = rb_hash_aref(cache.bitmaps, keyString(key));
+	rb_funcall(cache.evicted, rb_intern("[]="), 2, keyObject(key), obj);
+
+	cacheRemove(key);
+	++cache.evictions;
+}
+
+static void
+cacheInsert(const std::string &key, VALUE obj)
+{
+	Bitmap *b = getPrivateData<Bitmap>(obj);
+
+	CacheEntry entry;
+	entry.key = key;
+	entry.bytes = (size_t) b->width() * b->height() * 4;
+
+	cache.lru.push_front(entry);
+	cache.index.insert(key, cache.lru.begin());
+	cache.bytes += entry.bytes;
+
+	rb_hash_aset(cache.bitmaps, keyString(key), obj);
+
+	/* Never evict the entry we were just asked for */
+	while (cache.budget > 0 && cache.bytes > cache.budget
+	       && cache.lru.size() > 1)
+	{
+		cacheEvict(cache.lru.back().key);
+	}
+}
+
+/* Takes an evicted bitmap that is still alive back into the cache */
+static VALUE
+cacheRevive(const std::string &key)
+{
+	if (NIL_P(rb_hash_lookup(cache.keyObjs, keyString(key))))
+		return Qnil;
+
+	VALUE obj = rb_funcall(cache.evicted, rb_intern("[]"), 1, keyObject(key));
+
+	if (NIL_P(obj))
+		return Qnil;
+
+	Bitmap *b = getPrivateData<Bitmap>(obj);
+
+	if (!b || b->isDisposed())
+		return Qnil;
+
+	cacheInsert(key, obj);
+	++cache.revivals;
+
+	return obj;
+}
+
+/* Returns the cached bitmap for 'key' and marks it as
+ * recently used, or nil if there is none (anymore) */
+static VALUE
+cacheLookup(const std::string &key)
+{
+	if (!cache.index.contains(key))
+		return cacheRevive(key);
+
+	VALUE obj = rb_hash_aref(cache.bitmaps, keyString(key));
+	Bitmap *b = getPrivateData<Bitmap>(obj);
+
+	if (!b || b->isDisposed())
+	{
+		cacheRemove(key);
+		return Qnil;
+	}
+
+	EntryList::iterator iter = cache.index[key];
+	cache.lru.splice(cache.lru.begin(), cache.lru, iter);
+
+	return obj;
+}
+
+static VALUE
+newBitmap(int argc, VALUE *argv)
+{
+	VALUE klass = rb_const_get(rb_cObject, rb_intern("Bitmap"));
+
+	return rb_class_new_instance(argc, argv, klass);
+}
+
+static std::string
+variantKey(const std::string &path, int hue)
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "\x1fhue%d", hue);
+
+	return path + buf;
+}
+
+static VALUE
+loadBitmap(const std::string &path, bool empty)
+{
+	VALUE obj = cacheLookup(path);
+
+	if (!NIL_P(obj))
+		return obj;
+
+	if (empty)
+	{
+		VALUE args[] = { INT2FIX(32), INT2FIX(32) };
+		obj = newBitmap(2, args);
+	}
+	else
+	{
+		VALUE arg = keyString(path);
+		obj = newBitmap(1, &arg);
+	}
+
+	cacheInsert(path, obj);
+
+	return obj;
+}
+
+/* Hue rotations are periodic, so equivalent values share
+ * a single variant */
+static int
+normalizeHue(int hue)
+{
+	hue %= 360;
+
+	if (hue < 0)
+		hue += 360;
+
+	return hue;
+}
+
+static VALUE
+hueVariant(VALUE base, const std::string &key, int hue)
+{
+	VALUE obj = rb_funcall(base, rb_intern("clone"), 0);
+	rb_funcall(obj, rb_intern("hue_change"), 1, INT2FIX(hue));
+
+	cacheInsert(key, obj);
+
+	return obj;
+}
+
+RB_METHOD(rpgCacheLoadBitmap)
+{
+	RB_UNUSED_PARAM;
+
+	const char *folder;
+	const char *filename;
+	int hue = 0;
+
+	rb_get_args(argc, argv, "zz|i", &folder, &filename, &hue RB_ARG_END);
+
+	std::string path = std::string(folder) + filename;
+	hue = normalizeHue(hue);
+
+	VALUE obj = cacheLookup(hue == 0 ? path : variantKey(path, hue));
+
+	if (!NIL_P(obj))
+	{
+		++cache.hits;
+		return obj;
+	}
+
+	++cache.misses;
+
+	VALUE base = loadBitmap(path, *filename == '\0');
+
+	if (hue == 0)
+		return base;
+
+	return hueVariant(base, variantKey(path, hue), hue);
+}
+
+RB_METHOD(rpgCacheTile)
+{
+	RB_UNUSED_PARAM;
+
+	const char *filename;
+	int tileId;
+	int hue;
+
+	rb_get_args(argc, argv, "zii", &filename, &tileId, &hue RB_ARG_END);
+
+	char buf[32];
+	snprintf(buf, sizeof(buf), "\x1ftile%d", tileId);
+
+	std::string key = variantKey(std::string(filename) + buf, normalizeHue(hue));
+
+	VALUE obj = cacheLookup(key);
+
+	if (!NIL_P(obj))
+	{
+		++cache.hits;
+		return obj;
+	}
+
+	++cache.misses;
+
+	VALUE tileset = rb_funcall(rb_define_module_under(rb_define_module("RPG"), "Cache"),
+	                           rb_intern("tileset"), 1, rb_str_new_cstr(filename));
+
+	VALUE args[] = { INT2FIX(32), INT2FIX(32) };
+	obj = newBitmap(2, args);
+
+	Bitmap *tile = getPrivateData<Bitmap>(obj);
+	Bitmap *src = getPrivateData<Bitmap>(tileset);
+
+	int x = (tileId - 384) % 8 * 32;
+	int y = (tileId - 384) / 8 * 32;
+
+	GUARD_EXC( tile->blt(0, 0, *src, IntRect(x, y, 32, 32));
+	           tile->hueChange(hue); );
+
+	cacheInsert(key, obj);
+
+	return obj;
+}
+
+RB_METHOD(rpgCacheClear)
+{
+	RB_UNUSED_PARAM;
+
+	rb_hash_clear(cache.bitmaps);
+	rb_hash_clear(cache.keyObjs);
+	cache.evicted = newWeakMap();
+	cache.lru.clear();
+	cache.index.clear();
+	cache.bytes = 0;
+
+	rb_gc_start();
+
+	return Qnil;
+}
+
+static void
+statSet(VALUE hash, const char *name, unsigned long value)
+{
+	rb_hash_aset(hash, ID2SYM(rb_intern(name)), ULONG2NUM(value));
+}
+
+RB_METHOD(rpgCacheStats)
+{
+	RB_UNUSED_PARAM;
+
+	VALUE hash = rb_hash_new();
+
+	statSet(hash, "hits",      cache.hits);
+	statSet(hash, "misses",    cache.misses);
+	statSet(hash, "evictions", cache.evictions);
+	statSet(hash, "revivals",  cache.revivals);
+	statSet(hash, "entries",   cache.lru.size());
+	statSet(hash, "bytes",     cache.bytes);
+	statSet(hash, "budget",    cache.budget);
+
+	return hash;
+}
+
+/* Replaces the stock RPG::Cache functions (defined by module_rpg1),
+ * unless the native cache is disabled */
+void
+rpgCacheBindingInit()
+{
+	if (shState->config().rpgCacheSize <= 0)
+		return;
+
+	cache.bitmaps = rb_hash_new();
+	rb_gc_register_address(&cache.bitmaps);
+
+	cache.evicted = newWeakMap();
+	rb_gc_register_address(&cache.evicted);
+	cache.keyObjs = rb_hash_new();
+	rb_gc_register_address(&cache.keyObjs);
+
+	cache.bytes = 0;
+	cache.budget = (size_t) shState->config().rpgCacheSize * 1024 * 1024;
+	cache.hits = cache.misses = cache.evictions = cache.revivals = 0;
+
+	VALUE mod = rb_define_module_under(rb_define_module("RPG"), "Cache");
+
+	_rb_define_module_function(mod, "load_bitmap", rpgCacheLoadBitmap);
+	_rb_define_module_function(mod, "tile", rpgCacheTile);
+	_rb_define_module_function(mod, "clear", rpgCacheClear);
+	_rb_define_module_function(mod, "stats", rpgCacheStats);
+
+	/* Entries live in the native cache only */
+	rb_funcall(mod, rb_intern("remove_instance_variable"), 1, ID2SYM(rb_intern("@cache")));
+}
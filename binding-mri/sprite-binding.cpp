@@ -28,6 +28,10 @@
 #include "binding-util.h"
 #include "binding-types.h"
 
+#include <limits.h>
+#include <string.h>
+#include <vector>
+
 DEF_TYPE(Sprite);
 
 RB_METHOD(spriteInitialize)
@@ -51,6 +55,10 @@ DEF_PROP_OBJ_VAL(Sprite, Rect,   SrcRect, "src_rect")
 DEF_PROP_OBJ_VAL(Sprite, Color,  Color,   "color")
 DEF_PROP_OBJ_VAL(Sprite, Tone,   Tone,    "tone")
 
+DEF_PROP_OBJ_SET(Sprite, SrcRect, int,    4, 0)
+DEF_PROP_OBJ_SET(Sprite, Color,   double, 3, 255)
+DEF_PROP_OBJ_SET(Sprite, Tone,    double, 3, 0)
+
 DEF_PROP_I(Sprite, X)
 DEF_PROP_I(Sprite, Y)
 DEF_PROP_I(Sprite, OX)
@@ -94,6 +102,193 @@ RB_METHOD(spriteHeight)
 	return rb_fix_new(value);
 }
 
+/* Properties settable through Sprite.batch_update */
+enum BatchProp
+{
+	BatchX,
+	BatchY,
+	BatchOX,
+	BatchOY,
+	BatchZoomX,
+	BatchZoomY,
+	BatchAngle,
+	BatchOpacity,
+	BatchBushDepth,
+	BatchBlendType,
+	BatchMirror
+};
+
+static BatchProp
+batchPropFromSym(VALUE sym)
+{
+	if (!SYMBOL_P(sym))
+		rb_raise(rb_eTypeError, "Expected property name symbol");
+
+	static const struct
+	{
+		const char *name;
+		BatchProp prop;
+	} props[] =
+	{
+		{ "x",          BatchX         },
+		{ "y",          BatchY         },
+		{ "ox",         BatchOX        },
+		{ "oy",         BatchOY        },
+		{ "zoom_x",     BatchZoomX     },
+		{ "zoom_y",     BatchZoomY     },
+		{ "angle",      BatchAngle     },
+		{ "opacity",    BatchOpacity   },
+		{ "bush_depth", BatchBushDepth },
+		{ "blend_type", BatchBlendType },
+		{ "mirror",     BatchMirror    }
+	};
+
+	static ID ids[ARRAY_SIZE(props)];
+
+	if (!ids[0])
+		for (size_t i = 0; i < ARRAY_SIZE(props); ++i)
+			ids[i] = rb_intern(props[i].name);
+
+	ID id = SYM2ID(sym);
+
+	for (size_t i = 0; i < ARRAY_SIZE(props); ++i)
+		if (id == ids[i])
+			return props[i].prop;
+
+	rb_raise(rb_eArgError, "Unsupported batch property: %s", rb_id2name(id));
+}
+
+/* Properties that are integers in the regular setters */
+static bool
+batchPropIsInt(BatchProp prop)
+{
+	switch (prop)
+	{
+	case BatchZoomX :
+	case BatchZoomY :
+	case BatchAngle :
+	case BatchMirror :
+		return false;
+	default :
+		return true;
+	}
+}
+
+static void
+batchSet(Sprite *s, BatchProp prop, double value)
+{
+	switch (prop)
+	{
+	case BatchX :
+		s->setX(value);
+		break;
+	case BatchY :
+		s->setY(value);
+		break;
+	case BatchOX :
+		s->setOX(value);
+		break;
+	case BatchOY :
+		s->setOY(value);
+		break;
+	case BatchZoomX :
+		s->setZoomX(value);
+		break;
+	case BatchZoomY :
+		s->setZoomY(value);
+		break;
+	case BatchAngle :
+		s->setAngle(value);
+		break;
+	case BatchOpacity :
+		s->setOpacity(value);
+		break;
+	case BatchBushDepth :
+		s->setBushDepth(value);
+		break;
+	case BatchBlendType :
+		s->setBlendType(value);
+		break;
+	case BatchMirror :
+		s->setMirror(value != 0);
+		break;
+	}
+}
+
+/* Sprite.batch_update(sprites, props, values)
+ * Sets 'props' (array of property symbols) on every sprite in one go.
+ * 'values' holds one value per property for each sprite in turn,
+ * either as an array of numbers or as a string of packed native
+ * floats (Array#pack("f*")). Mirror is set for any non-zero value */
+RB_METHOD(spriteBatchUpdate)
+{
+	RB_UNUSED_PARAM;
+
+	VALUE spritesObj, propsObj, valuesObj;
+
+	rb_get_args_fixed(argc, argv, &spritesObj, &propsObj, &valuesObj);
+
+	Check_Type(spritesObj, T_ARRAY);
+	Check_Type(propsObj, T_ARRAY);
+
+	long spriteCount = RARRAY_LEN(spritesObj);
+	long propCount = RARRAY_LEN(propsObj);
+
+	std::vector<BatchProp> props(propCount);
+
+	for (long i = 0; i < propCount; ++i)
+		props[i] = batchPropFromSym(rb_ary_entry(propsObj, i));
+
+	long valueCount = spriteCount * propCount;
+	const float *packed = 0;
+
+	if (RB_TYPE_P(valuesObj, RUBY_T_STRING))
+	{
+		if (RSTRING_LEN(valuesObj) != (long) (valueCount * sizeof(float)))
+			rb_raise(rb_eArgError, "Expected %ld packed floats", valueCount);
+
+		packed = reinterpret_cast<const float*>(RSTRING_PTR(valuesObj));
+	}
+	else
+	{
+		Check_Type(valuesObj, T_ARRAY);
+
+		if (RARRAY_LEN(valuesObj) != valueCount)
+			rb_raise(rb_eArgError, "Expected %ld values", valueCount);
+	}
+
+	for (long i = 0; i < spriteCount; ++i)
+	{
+		Sprite *s = getPrivateDataCheck<Sprite>(rb_ary_entry(spritesObj, i), SpriteType);
+
+		for (long j = 0; j < propCount; ++j)
+		{
+			long idx = i * propCount + j;
+			double value;
+
+			if (packed)
+			{
+				float f;
+				memcpy(&f, packed + idx, sizeof(f));
+				value = f;
+			}
+			else
+			{
+				rb_float_arg(rb_ary_entry(valuesObj, idx), &value, idx);
+			}
+
+			/* Same as NUM2INT would raise (the negated
+			 * comparison also catches NaN) */
+			if (batchPropIsInt(props[j]) && !(value >= INT_MIN && value <= INT_MAX))
+				rb_raise(rb_eRangeError, "float %g out of range of integer", value);
+
+			GUARD_EXC( batchSet(s, props[j], value); );
+		}
+	}
+
+	return spritesObj;
+}
+
 void
 spriteBindingInit()
 {
@@ -106,6 +301,8 @@ spriteBindingInit()
 
 	_rb_define_method(klass, "initialize", spriteInitialize);
 
+	rb_define_class_method(klass, "batch_update", spriteBatchUpdate);
+
 	INIT_PROP_BIND( Sprite, Bitmap,    "bitmap"     );
 	INIT_PROP_BIND( Sprite, SrcRect,   "src_rect"   );
 	INIT_PROP_BIND( Sprite, X,         "x"          );
@@ -122,6 +319,10 @@ spriteBindingInit()
 	INIT_PROP_BIND( Sprite, Color,     "color"      );
 	INIT_PROP_BIND( Sprite, Tone,      "tone"       );
 
+	INIT_PROP_SET_BIND( Sprite, SrcRect, "src_rect" );
+	INIT_PROP_SET_BIND( Sprite, Color,   "color"    );
+	INIT_PROP_SET_BIND( Sprite, Tone,    "tone"     );
+
 	if (rgssVer >= 2)
 	{
 	_rb_define_method(klass, "width", spriteWidth);
@@ -20,6 +20,8 @@
 */
 
 #include <algorithm>
+#include <vector>
+#include <string.h>
 #include "table.h"
 #include "binding-util.h"
 #include "serializable-binding.h"
@@ -158,6 +160,163 @@ RB_METHOD(tableSetAt)
 MARSH_LOAD_FUN(Table)
 INITCOPY_FUN(Table)
 
+static void parseArgsRegion(VALUE *argv, int *region)
+{
+	for (int i = 0; i < 6; ++i)
+		region[i] = NUM2INT(argv[i]);
+}
+
+/* fill(value [, x, y, z, xsize, ysize, zsize]) */
+RB_METHOD(tableFill)
+{
+	Table *t = getPrivateData<Table>(self);
+
+	if (argc != 1 && argc != 7)
+		rb_raise(rb_eArgError, "wrong number of arguments");
+
+	int value = NUM2INT(argv[0]);
+
+	if (argc == 1)
+	{
+		t->fill(value);
+		return self;
+	}
+
+	int r[6];
+	parseArgsRegion(argv+1, r);
+
+	t->fill(value, r[0], r[1], r[2], r[3], r[4], r[5]);
+
+	return self;
+}
+
+/* blit(src, dst_x, dst_y, dst_z [, src_x, src_y, src_z, xsize, ysize, zsize]) */
+RB_METHOD(tableBlit)
+{
+	Table *t = getPrivateData<Table>(self);
+
+	if (argc != 4 && argc != 10)
+		rb_raise(rb_eArgError, "wrong number of arguments");
+
+	Table *src = getPrivateDataCheck<Table>(argv[0], TableType);
+
+	int dst[3];
+	for (int i = 0; i < 3; ++i)
+		dst[i] = NUM2INT(argv[1+i]);
+
+	int r[6] = { 0, 0, 0, src->xSize(), src->ySize(), src->zSize() };
+
+	if (argc == 10)
+		parseArgsRegion(argv+4, r);
+
+	t->blit(*src, r[0], r[1], r[2], r[3], r[4], r[5], dst[0], dst[1], dst[2]);
+
+	return self;
+}
+
+/* copy_from(src [, x, y, z, xsize, ysize, zsize])
+ * Without a region, takes on the size and contents of 'src' */
+RB_METHOD(tableCopyFrom)
+{
+	Table *t = getPrivateData<Table>(self);
+
+	if (argc != 1 && argc != 7)
+		rb_raise(rb_eArgError, "wrong number of arguments");
+
+	Table *src = getPrivateDataCheck<Table>(argv[0], TableType);
+
+	if (argc == 1)
+	{
+		t->resize(src->xSize(), src->ySize(), src->zSize());
+		t->setRawData(src->rawData());
+
+		return self;
+	}
+
+	int r[6];
+	parseArgsRegion(argv+1, r);
+
+	t->blit(*src, r[0], r[1], r[2], r[3], r[4], r[5], r[0], r[1], r[2]);
+
+	return self;
+}
+
+RB_METHOD(tableEqual)
+{
+	VALUE otherObj;
+	rb_get_args_fixed(argc, argv, &otherObj);
+
+	if (!rb_typeddata_is_kind_of(otherObj, &TableType))
+		return Qfalse;
+
+	Table *t = getPrivateData<Table>(self);
+	Table *other = getPrivateData<Table>(otherObj);
+
+	return rb_bool_new(*t == *other);
+}
+
+/* Returns the bounding box [x, y, z, xsize, ysize, zsize]
+ * of all cells differing from 'other', or nil */
+RB_METHOD(tableDiff)
+{
+	VALUE otherObj;
+	rb_get_args_fixed(argc, argv, &otherObj);
+
+	Table *t = getPrivateData<Table>(self);
+	Table *other = getPrivateDataCheck<Table>(otherObj, TableType);
+
+	if (t->xSize() != other->xSize() || t->ySize() != other->ySize()
+	||  t->zSize() != other->zSize())
+		rb_raise(rb_eArgError, "Table sizes differ");
+
+	int box[6];
+
+	if (!t->diff(*other, box))
+		return Qnil;
+
+	VALUE ary = rb_ary_new2(6);
+	for (int i = 0; i < 6; ++i)
+		rb_ary_push(ary, INT2FIX(box[i]));
+
+	return ary;
+}
+
+/* Cells as packed native 16 bit integers (Array#pack("s*")) */
+RB_METHOD(tablePack)
+{
+	RB_UNUSED_PARAM;
+
+	Table *t = getPrivateData<Table>(self);
+	long size = (long) t->xSize() * t->ySize() * t->zSize();
+
+	return rb_str_new(reinterpret_cast<const char*>(t->rawData()),
+	                  size * sizeof(int16_t));
+}
+
+RB_METHOD(tableUnpack)
+{
+	Table *t = getPrivateData<Table>(self);
+
+	VALUE str;
+	rb_get_args(argc, argv, "S", &str RB_ARG_END);
+
+	long size = (long) t->xSize() * t->ySize() * t->zSize();
+
+	if (RSTRING_LEN(str) != (long) (size * sizeof(int16_t)))
+		rb_raise(rb_eArgError, "Expected %ld packed values", size);
+
+	/* Copy first, the string data might be unaligned */
+	std::vector<int16_t> values(size);
+
+	if (size > 0)
+	{
+		memcpy(&values[0], RSTRING_PTR(str), size * sizeof(int16_t));
+		t->setRawData(&values[0]);
+	}
+
+	return self;
+}
+
 void
 tableBindingInit()
 {
@@ -176,5 +335,12 @@ tableBindingInit()
 	_rb_define_method(klass, "zsize", tableZSize);
 	_rb_define_method(klass, "[]", tableGetAt);
 	_rb_define_method(klass, "[]=", tableSetAt);
+	_rb_define_method(klass, "fill", tableFill);
+	_rb_define_method(klass, "blit", tableBlit);
+	_rb_define_method(klass, "copy_from", tableCopyFrom);
+	_rb_define_method(klass, "==", tableEqual);
+	_rb_define_method(klass, "diff", tableDiff);
+	_rb_define_method(klass, "pack", tablePack);
+	_rb_define_method(klass, "unpack", tableUnpack);
 
 }
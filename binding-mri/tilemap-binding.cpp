@@ -37,13 +37,13 @@ RB_METHOD(tilemapAutotilesSet)
 	int i;
 	VALUE bitmapObj;
 
-	rb_get_args(argc, argv, "io", &i, &bitmapObj RB_ARG_END);
+	rb_get_args_fixed(argc, argv, &i, &bitmapObj);
 
 	Bitmap *bitmap = getPrivateDataCheck<Bitmap>(bitmapObj, BitmapType);
 
 	a->set(i, bitmap);
 
-	VALUE ary = rb_iv_get(self, "array");
+	VALUE ary = rb_ivar_get(self, RB_ID("array"));
 	rb_ary_store(ary, i, bitmapObj);
 
 	return self;
@@ -52,12 +52,12 @@ RB_METHOD(tilemapAutotilesSet)
 RB_METHOD(tilemapAutotilesGet)
 {
 	int i;
-	rb_get_args (argc, argv, "i", &i RB_ARG_END);
+	rb_get_args_fixed(argc, argv, &i);
 
 	if (i < 0 || i > 6)
 		return Qnil;
 
-	VALUE ary = rb_iv_get(self, "array");
+	VALUE ary = rb_ivar_get(self, RB_ID("array"));
 
 	return rb_ary_entry(ary, i);
 }
@@ -82,21 +82,21 @@ RB_METHOD(tilemapInitialize)
 
 	setPrivateData(self, t);
 
-	rb_iv_set(self, "viewport", viewportObj);
+	rb_ivar_set(self, RB_ID("viewport"), viewportObj);
 
 	wrapProperty(self, &t->getAutotiles(), "autotiles", TilemapAutotilesType);
 
-	VALUE autotilesObj = rb_iv_get(self, "autotiles");
+	VALUE autotilesObj = rb_ivar_get(self, RB_ID("autotiles"));
 
 	VALUE ary = rb_ary_new2(7);
 	for (int i = 0; i < 7; ++i)
 		rb_ary_push(ary, Qnil);
 
-	rb_iv_set(autotilesObj, "array", ary);
+	rb_ivar_set(autotilesObj, RB_ID("array"), ary);
 
 	/* Circular reference so both objects are always
 	 * alive at the same time */
-	rb_iv_set(autotilesObj, "tilemap", self);
+	rb_ivar_set(autotilesObj, RB_ID("tilemap"), self);
 
 	return self;
 }
@@ -107,7 +107,7 @@ RB_METHOD(tilemapGetAutotiles)
 
 	checkDisposed<Tilemap>(self);
 
-	return rb_iv_get(self, "autotiles");
+	return rb_ivar_get(self, RB_ID("autotiles"));
 }
 
 RB_METHOD(tilemapUpdate)
@@ -127,7 +127,7 @@ RB_METHOD(tilemapGetViewport)
 
 	checkDisposed<Tilemap>(self);
 
-	return rb_iv_get(self, "viewport");
+	return rb_ivar_get(self, RB_ID("viewport"));
 }
 
 DEF_PROP_OBJ_REF(Tilemap, Bitmap,   Tileset,    "tileset")
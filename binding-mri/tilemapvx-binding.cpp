@@ -51,22 +51,22 @@ RB_METHOD(tilemapVXInitialize)
 
 	setPrivateData(self, t);
 
-	rb_iv_set(self, "viewport", viewportObj);
+	rb_ivar_set(self, RB_ID("viewport"), viewportObj);
 
 	wrapProperty(self, &t->getBitmapArray(), "bitmap_array", BitmapArrayType,
 	             rb_const_get(rb_cObject, rb_intern("Tilemap")));
 
-	VALUE autotilesObj = rb_iv_get(self, "bitmap_array");
+	VALUE autotilesObj = rb_ivar_get(self, RB_ID("bitmap_array"));
 
 	VALUE ary = rb_ary_new2(9);
 	for (int i = 0; i < 9; ++i)
 		rb_ary_push(ary, Qnil);
 
-	rb_iv_set(autotilesObj, "array", ary);
+	rb_ivar_set(autotilesObj, RB_ID("array"), ary);
 
 	/* Circular reference so both objects are always
 	 * alive at the same time */
-	rb_iv_set(autotilesObj, "tilemap", self);
+	rb_ivar_set(autotilesObj, RB_ID("tilemap"), self);
 
 	return self;
 }
@@ -77,7 +77,7 @@ RB_METHOD(tilemapVXGetBitmapArray)
 
 	checkDisposed<TilemapVX>(self);
 
-	return rb_iv_get(self, "bitmap_array");
+	return rb_ivar_get(self, RB_ID("bitmap_array"));
 }
 
 RB_METHOD(tilemapVXUpdate)
@@ -108,13 +108,13 @@ RB_METHOD(tilemapVXBitmapsSet)
 	int i;
 	VALUE bitmapObj;
 
-	rb_get_args(argc, argv, "io", &i, &bitmapObj RB_ARG_END);
+	rb_get_args_fixed(argc, argv, &i, &bitmapObj);
 
 	Bitmap *bitmap = getPrivateDataCheck<Bitmap>(bitmapObj, BitmapType);
 
 	a->set(i, bitmap);
 
-	VALUE ary = rb_iv_get(self, "array");
+	VALUE ary = rb_ivar_get(self, RB_ID("array"));
 	rb_ary_store(ary, i, bitmapObj);
 
 	return self;
@@ -123,12 +123,12 @@ RB_METHOD(tilemapVXBitmapsSet)
 RB_METHOD(tilemapVXBitmapsGet)
 {
 	int i;
-	rb_get_args (argc, argv, "i", &i RB_ARG_END);
+	rb_get_args_fixed(argc, argv, &i);
 
 	if (i < 0 || i > 8)
 		return Qnil;
 
-	VALUE ary = rb_iv_get(self, "array");
+	VALUE ary = rb_ivar_get(self, RB_ID("array"));
 
 	return rb_ary_entry(ary, i);
 }
@@ -71,7 +71,7 @@ RB_METHOD(viewportInitialize)
 	/* 'elements' holds all SceneElements that become children
 	 * of this viewport, so we can dispose them when the viewport
 	 * is disposed */
-	rb_iv_set(self, "elements", rb_ary_new());
+	rb_ivar_set(self, RB_ID("elements"), rb_ary_new());
 
 	return self;
 }
@@ -80,6 +80,10 @@ DEF_PROP_OBJ_VAL(Viewport, Rect,  Rect,  "rect")
 DEF_PROP_OBJ_VAL(Viewport, Color, Color, "color")
 DEF_PROP_OBJ_VAL(Viewport, Tone,  Tone,  "tone")
 
+DEF_PROP_OBJ_SET(Viewport, Rect,  int,    4, 0)
+DEF_PROP_OBJ_SET(Viewport, Color, double, 3, 255)
+DEF_PROP_OBJ_SET(Viewport, Tone,  double, 3, 0)
+
 DEF_PROP_I(Viewport, OX)
 DEF_PROP_I(Viewport, OY)
 
@@ -101,5 +105,9 @@ viewportBindingInit()
 	INIT_PROP_BIND( Viewport, OY,    "oy"    );
 	INIT_PROP_BIND( Viewport, Color, "color" );
 	INIT_PROP_BIND( Viewport, Tone,  "tone"  );
+
+	INIT_PROP_SET_BIND( Viewport, Rect,  "rect"  );
+	INIT_PROP_SET_BIND( Viewport, Color, "color" );
+	INIT_PROP_SET_BIND( Viewport, Tone,  "tone"  );
 }
 
@@ -37,7 +37,7 @@ RB_METHOD(viewportElementGetViewport)
 
 	checkDisposed<C>(self);
 
-	return rb_iv_get(self, "viewport");
+	return rb_ivar_get(self, RB_ID("viewport"));
 }
 
 template<class C>
@@ -47,17 +47,17 @@ RB_METHOD(viewportElementSetViewport)
 
 	ViewportElement *ve = getPrivateData<C>(self);
 
-	VALUE viewportObj = Qnil;
-	Viewport *viewport = 0;
+	rb_check_argc(argc, 1);
 
-	rb_get_args(argc, argv, "o", &viewportObj RB_ARG_END);
+	VALUE viewportObj = *argv;
+	Viewport *viewport = 0;
 
 	if (!NIL_P(viewportObj))
 		viewport = getPrivateDataCheck<Viewport>(viewportObj, ViewportType);
 
 	GUARD_EXC( ve->setViewport(viewport); );
 
-	rb_iv_set(self, "viewport", viewportObj);
+	rb_ivar_set(self, RB_ID("viewport"), viewportObj);
 
 	return viewportObj;
 }
@@ -84,7 +84,7 @@ viewportElementInitialize(int argc, VALUE *argv, VALUE self)
 	C *ve = new C(viewport);
 
 	/* Set property objects */
-	rb_iv_set(self, "viewport", viewportObj);
+	rb_ivar_set(self, RB_ID("viewport"), viewportObj);
 
 	return ve;
 }
@@ -54,6 +54,8 @@ DEF_PROP_OBJ_REF(Window, Bitmap, Windowskin, "windowskin")
 DEF_PROP_OBJ_REF(Window, Bitmap, Contents,   "contents")
 DEF_PROP_OBJ_VAL(Window, Rect,   CursorRect, "cursor_rect")
 
+DEF_PROP_OBJ_SET(Window, CursorRect, int, 4, 0)
+
 DEF_PROP_B(Window, Stretch)
 DEF_PROP_B(Window, Active)
 DEF_PROP_B(Window, Pause)
@@ -85,6 +87,7 @@ windowBindingInit()
 	INIT_PROP_BIND( Window, Contents,        "contents"         );
 	INIT_PROP_BIND( Window, Stretch,         "stretch"          );
 	INIT_PROP_BIND( Window, CursorRect,      "cursor_rect"      );
+	INIT_PROP_SET_BIND( Window, CursorRect,  "cursor_rect"      );
 	INIT_PROP_BIND( Window, Active,          "active"           );
 	INIT_PROP_BIND( Window, Pause,           "pause"            );
 	INIT_PROP_BIND( Window, X,               "x"                );
@@ -61,7 +61,7 @@ RB_METHOD(windowVXInitialize)
 	Bitmap *contents = new Bitmap(1, 1);
 	VALUE contentsObj = wrapObject(contents, BitmapType);
 	bitmapInitProps(contents, contentsObj);
-	rb_iv_set(self, "contents", contentsObj);
+	rb_ivar_set(self, RB_ID("contents"), contentsObj);
 
 	return self;
 }
@@ -113,6 +113,9 @@ DEF_PROP_OBJ_REF(WindowVX, Bitmap, Contents, "contents")
 DEF_PROP_OBJ_VAL(WindowVX, Rect, CursorRect, "cursor_rect")
 DEF_PROP_OBJ_VAL(WindowVX, Tone, Tone,       "tone")
 
+DEF_PROP_OBJ_SET(WindowVX, CursorRect, int,    4, 0)
+DEF_PROP_OBJ_SET(WindowVX, Tone,       double, 3, 0)
+
 DEF_PROP_I(WindowVX, X)
 DEF_PROP_I(WindowVX, Y)
 DEF_PROP_I(WindowVX, OX)
@@ -145,6 +148,7 @@ windowVXBindingInit()
 	INIT_PROP_BIND( WindowVX, Windowskin,      "windowskin"       );
 	INIT_PROP_BIND( WindowVX, Contents,        "contents"         );
 	INIT_PROP_BIND( WindowVX, CursorRect,      "cursor_rect"      );
+	INIT_PROP_SET_BIND( WindowVX, CursorRect,  "cursor_rect"      );
 	INIT_PROP_BIND( WindowVX, Active,          "active"           );
 	INIT_PROP_BIND( WindowVX, Pause,           "pause"            );
 	INIT_PROP_BIND( WindowVX, X,               "x"                );
@@ -168,5 +172,6 @@ windowVXBindingInit()
 	INIT_PROP_BIND( WindowVX, Padding,         "padding"          );
 	INIT_PROP_BIND( WindowVX, PaddingBottom,   "padding_bottom"   );
 	INIT_PROP_BIND( WindowVX, Tone,            "tone"             );
+	INIT_PROP_SET_BIND( WindowVX, Tone,        "tone"             );
 	}
 }
@@ -31,9 +31,11 @@
 #include <mruby/dump.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <zlib.h>
 
 #include <string>
+#include <vector>
 
 #include <SDL_messagebox.h>
 #include <SDL_rwops.h>
@@ -44,10 +46,12 @@
 #include "eventthread.h"
 #include "filesystem.h"
 #include "exception.h"
+#include "boost-hash.h"
 
 #include "binding-util.h"
 #include "binding-types.h"
 #include "mrb-ext/marshal.h"
+#include "scriptcache.h"
 
 static void mrbBindingExecute();
 static void mrbBindingTerminate();
@@ -197,6 +201,35 @@ showError(const std::string &msg)
 	shState->eThread().showMessageBox(msg.c_str());
 }
 
+/* Runs a script from its bytecode if there is any, from source otherwise */
+static void
+runScript(mrb_state *mrb, mrbc_context *ctx, const std::string &name,
+          const std::string &source, const std::string &binary)
+{
+	int ai = mrb_gc_arena_save(mrb);
+
+	mrb_irep *irep = 0;
+
+	if (!binary.empty())
+		irep = mrb_read_irep(mrb, reinterpret_cast<const uint8_t*>(binary.c_str()));
+
+	/* Execute code */
+	if (irep)
+	{
+		RProc *proc = mrb_proc_new(mrb, irep);
+		mrb_run(mrb, proc, mrb_top_self(mrb));
+	}
+	else
+	{
+		ctx->filename = const_cast<char*>(name.c_str());
+		ctx->lineno = 1;
+
+		mrb_load_nstring_cxt(mrb, source.c_str(), source.size(), ctx);
+	}
+
+	mrb_gc_arena_restore(mrb, ai);
+}
+
 static void
 runCustomScript(mrb_state *mrb, mrbc_context *ctx, const char *filename)
 {
@@ -212,14 +245,29 @@ runCustomScript(mrb_state *mrb, mrbc_context *ctx, const char *filename)
 		return;
 	}
 
-	ctx->filename = strdup(filename);
-	ctx->lineno = 1;
+	std::string source;
+	char buffer[0x10000];
+	size_t count;
 
-	/* Run code */
-	mrb_load_file_cxt(mrb, f, ctx);
+	while ((count = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		source.append(buffer, count);
 
-	free(ctx->filename);
 	fclose(f);
+
+	const Config &conf = shState->rtData().config;
+	std::string binary;
+
+	if (conf.scriptCache)
+	{
+		ScriptCache cache;
+		cache.init(conf.customDataPath.empty() ? conf.commonDataPath : conf.customDataPath,
+		           std::string(filename) + ".mrbcache", "custom");
+
+		binary = cache.compile(mrb, filename, source);
+		cache.write();
+	}
+
+	runScript(mrb, ctx, filename, source, binary);
 }
 
 static void
@@ -300,6 +348,9 @@ runRMXPScripts(mrb_state *mrb, mrbc_context *ctx)
 
 	int scriptCount = mrb_ary_len(scriptMrb, scriptArray);
 
+	std::vector<std::string> names;
+	std::vector<std::string> sources;
+
 	std::string decodeBuffer;
 	decodeBuffer.resize(0x1000);
 
@@ -347,21 +398,36 @@ runRMXPScripts(mrb_state *mrb, mrbc_context *ctx)
 			break;
 		}
 
-		ctx->filename = RSTRING_PTR(scriptName);
-		ctx->lineno = 1;
+		names.push_back(RSTRING_PTR(scriptName));
+		sources.push_back(std::string(decodeBuffer.c_str(), bufferLen));
+	}
 
-		int ai = mrb_gc_arena_save(mrb);
+	/* Compile everything upfront (in the util state), so the
+	 * cache can be written before the game enters its main loop */
+	const Config &conf = shState->rtData().config;
+	std::vector<std::string> binaries(sources.size());
 
-		/* Execute code */
-		mrb_load_nstring_cxt(mrb, decodeBuffer.c_str(), bufferLen, ctx);
+	if (conf.scriptCache)
+	{
+		ScriptCache cache;
+		cache.init(conf.customDataPath.empty() ? conf.commonDataPath : conf.customDataPath,
+		           scriptPack + ".mrbcache");
 
-		mrb_gc_arena_restore(mrb, ai);
+		for (size_t i = 0; i < sources.size(); ++i)
+			binaries[i] = cache.compile(scriptMrb, names[i], sources[i]);
 
-		if (mrb->exc)
-			break;
+		cache.write();
 	}
 
 	mrb_close(scriptMrb);
+
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		runScript(mrb, ctx, names[i], sources[i], binaries[i]);
+
+		if (mrb->exc)
+			break;
+	}
 }
 
 static void mrbBindingExecute()
@@ -20,10 +20,15 @@
 */
 
 #include "binding-util.h"
+#include "sharedstate.h"
+#include "texpool.h"
+#include "imagecache.h"
+#include "config.h"
 #include "util.h"
 #include "exception.h"
 
 #include <string.h>
+#include <algorithm>
 
 #define SYMD(symbol) { CS##symbol, #symbol }
 
@@ -102,6 +107,7 @@ static const MrbExcData enoExcData[] =
 static elementsN(enoExcData);
 
 MrbData::MrbData(mrb_state *mrb)
+    : texMemGCTrigger(0)
 {
 	int arena = mrb_gc_arena_save(mrb);
 
@@ -161,6 +167,35 @@ raiseDisposedAccess(mrb_state *mrb, mrb_value self)
 	           "disposed %S", mrb_str_new_cstr(mrb, buf));
 }
 
+static uint64_t
+texMemUsed()
+{
+	return shState->texPool().usedMemSize() - shState->imageCache().retainedMemSize();
+}
+
+void
+reportTexMemory(mrb_state *mrb)
+{
+	MrbData *data = getMrbData(mrb);
+
+	uint64_t used = texMemUsed();
+	const uint64_t watermark = (uint64_t) std::max(shState->config().vramGCWatermark, 0) * 1024 * 1024;
+
+	if (watermark == 0)
+		return;
+
+	if (used <= watermark)
+		data->texMemGCTrigger = watermark;
+
+	if (used > data->texMemGCTrigger)
+	{
+		mrb_full_gc(mrb);
+
+		used = texMemUsed();
+		data->texMemGCTrigger = std::max(watermark, used + watermark / 2);
+	}
+}
+
 MRB_METHOD_PUB(inspectObject)
 {
 	static char buffer[64];
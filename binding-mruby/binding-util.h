@@ -103,6 +103,9 @@ struct MrbData
 
 	mrb_value buttoncodeHash;
 
+	/* Texture memory above which a GC is forced */
+	uint64_t texMemGCTrigger;
+
 	MrbData(mrb_state *mrb);
 };
 
@@ -259,6 +262,13 @@ getSym(mrb_state *mrb, CommonSymbol sym)
 void
 raiseDisposedAccess(mrb_state *mrb, mrb_value self);
 
+/* mruby's GC can't be told about memory held outside of it,
+ * so this only forces a collection once 'vramGCWatermark' is
+ * crossed (not counting textures only the image cache retains).
+ * Called on every Graphics.update and after creating bitmaps */
+void
+reportTexMemory(mrb_state *mrb);
+
 template<class C>
 inline C *
 getPrivateData(mrb_state *, mrb_value self)
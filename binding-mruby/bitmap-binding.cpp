@@ -62,6 +62,8 @@ MRB_METHOD(bitmapInitialize)
 	if (rgssVer >= 3)
 		wrapProperty(mrb, fontProp, &font->getOutColor(), CSout_color, ColorType);
 
+	reportTexMemory(mrb);
+
 	return self;
 }
 
@@ -30,6 +30,8 @@ MRB_FUNCTION(graphicsUpdate)
 
 	shState->graphics().update();
 
+	reportTexMemory(mrb);
+
 	return mrb_nil_value();
 }
 
@@ -0,0 +1,292 @@
+/*
+** scriptc.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* mkxp-scriptc: precompiles a game's script sections for the mruby
+ * binding, so they don't have to be parsed on the target device.
+ *
+ * Usage: mkxp-scriptc <Scripts.rxdata> [output]
+ *
+ * The output (by default the input path plus ".mrbcache") is to be
+ * shipped next to the scripts file. It must be built against the
+ * same mruby as the engine, or it will be ignored */
+
+#include "../scriptcache.h"
+
+#include <zlib.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+/* Reads the subset of Marshal that script archives are made of:
+ * an array of [id, name, deflated source] arrays */
+struct ScriptReader
+{
+	const std::string &data;
+	size_t pos;
+
+	/* Strings by object index, for '@' links
+	 * (other objects are left empty) */
+	std::vector<std::string> objects;
+
+	ScriptReader(const std::string &data)
+	    : data(data), pos(0)
+	{}
+
+	void fail()
+	{
+		throw std::runtime_error("unexpected script archive format");
+	}
+
+	int byte()
+	{
+		if (pos >= data.size())
+			fail();
+
+		return (unsigned char) data[pos++];
+	}
+
+	long integer()
+	{
+		int c = (signed char) byte();
+
+		if (c == 0)
+			return 0;
+		if (c > 4)
+			return c - 5;
+		if (c < -4)
+			return c + 5;
+
+		long x = (c > 0) ? 0 : -1;
+		int len = (c > 0) ? c : -c;
+
+		for (int i = 0; i < len; ++i)
+		{
+			x &= ~(0xFFL << (8*i));
+			x |= (long) byte() << (8*i);
+		}
+
+		return x;
+	}
+
+	std::string bytes()
+	{
+		long len = integer();
+
+		if (len < 0 || (size_t) len > data.size() - pos)
+			fail();
+
+		std::string result = data.substr(pos, len);
+		pos += len;
+
+		return result;
+	}
+
+	void symbol()
+	{
+		int type = byte();
+
+		if (type == ';')
+		{
+			integer();
+			return;
+		}
+
+		if (type != ':')
+			fail();
+
+		bytes();
+	}
+
+	/* Strings (possibly carrying ivars such as
+	 * their encoding), integers and booleans */
+	std::string value()
+	{
+		int type = byte();
+
+		switch (type)
+		{
+		case 'T' :
+		case 'F' :
+		case '0' :
+			return std::string();
+
+		case 'i' :
+			integer();
+			return std::string();
+
+		case '@' :
+		{
+			long idx = integer();
+
+			if (idx < 0 || (size_t) idx >= objects.size())
+				fail();
+
+			return objects[idx];
+		}
+
+		case '"' :
+			objects.push_back(bytes());
+			return objects.back();
+
+		case 'I' :
+		{
+			if (byte() != '"')
+				fail();
+
+			size_t idx = objects.size();
+			objects.push_back(bytes());
+
+			long count = integer();
+
+			for (long i = 0; i < count; ++i)
+			{
+				symbol();
+				value();
+			}
+
+			return objects[idx];
+		}
+
+		default :
+			fail();
+		}
+
+		return std::string();
+	}
+
+	long arrayHeader()
+	{
+		if (byte() != '[')
+			fail();
+
+		objects.push_back(std::string());
+
+		return integer();
+	}
+};
+
+static std::string
+readFile(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+
+	if (!f)
+		throw std::runtime_error(std::string("cannot open ") + filename);
+
+	std::string result;
+	char buffer[0x10000];
+	size_t count;
+
+	while ((count = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		result.append(buffer, count);
+
+	fclose(f);
+
+	return result;
+}
+
+static std::string
+inflate(const std::string &data)
+{
+	std::string result(0x1000, '\0');
+
+	while (true)
+	{
+		uLongf len = result.size();
+		int status = uncompress(reinterpret_cast<Bytef*>(&result[0]), &len,
+		                        reinterpret_cast<const Bytef*>(data.c_str()), data.size());
+
+		if (status == Z_OK)
+		{
+			result.resize(len);
+			return result;
+		}
+
+		if (status != Z_BUF_ERROR)
+			throw std::runtime_error("cannot decode script");
+
+		result.resize(result.size() * 2);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		fprintf(stderr, "Usage: %s <Scripts.rxdata> [output]\n", argv[0]);
+		return 2;
+	}
+
+	std::string output = (argc > 2) ? argv[2] : std::string(argv[1]) + ".mrbcache";
+
+	mrb_state *mrb = mrb_open();
+	ScriptCache cache;
+	size_t failed = 0;
+
+	try
+	{
+		std::string data = readFile(argv[1]);
+		ScriptReader reader(data);
+
+		if (reader.byte() != 4 || reader.byte() != 8)
+			reader.fail();
+
+		long count = reader.arrayHeader();
+
+		for (long i = 0; i < count; ++i)
+		{
+			if (reader.arrayHeader() != 3)
+				reader.fail();
+
+			reader.value();
+			std::string name = reader.value();
+			std::string source = inflate(reader.value());
+
+			if (cache.compile(mrb, name, source).empty())
+			{
+				fprintf(stderr, "Script '%s' does not compile, left out\n", name.c_str());
+				++failed;
+			}
+		}
+	}
+	catch (const std::exception &e)
+	{
+		fprintf(stderr, "%s: %s\n", argv[1], e.what());
+		mrb_close(mrb);
+
+		return 1;
+	}
+
+	mrb_close(mrb);
+
+	if (!cache.writeFile(output))
+	{
+		fprintf(stderr, "Cannot write %s\n", output.c_str());
+		return 1;
+	}
+
+	printf("Wrote %d sections to %s (mruby %s)\n",
+	       (int) cache.used.size(), output.c_str(), MRUBY_VERSION);
+
+	return failed ? 1 : 0;
+}
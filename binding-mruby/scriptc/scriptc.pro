@@ -0,0 +1,33 @@
+# Precompiles Scripts.rxdata for the mruby binding,
+# see scriptc.cpp. Build against the engine's mruby:
+#   qmake binding-mruby/scriptc/scriptc.pro && make
+
+TEMPLATE = app
+QT =
+TARGET = mkxp-scriptc
+CONFIG += console
+CONFIG -= app_bundle
+INCLUDEPATH += ../../src ../../mruby/include
+
+CONFIG += c++11
+# And for older qmake versions..
+QMAKE_CXXFLAGS += -std=c++11
+
+LIBS += ../../mruby/build/host/lib/libmruby.a
+
+unix {
+	CONFIG += link_pkgconfig
+	PKGCONFIG += zlib
+
+	isEmpty(BOOST_I) {
+		BOOST_I = $$(BOOST_I)
+	}
+	isEmpty(BOOST_I) {}
+	else {
+		INCLUDEPATH += $$BOOST_I
+	}
+}
+
+HEADERS += ../scriptcache.h
+
+SOURCES += scriptc.cpp
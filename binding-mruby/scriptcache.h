@@ -0,0 +1,250 @@
+/*
+** scriptcache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCRIPTCACHE_H
+#define SCRIPTCACHE_H
+
+#include <mruby.h>
+#include <mruby/compile.h>
+#include <mruby/proc.h>
+#include <mruby/dump.h>
+#include <mruby/version.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost-hash.h"
+
+#define SCRIPT_CACHE_VER 1
+
+/* Keeps the compiled bytecode of script sections between launches.
+ * Entries are keyed by a hash of the section's name and source, the
+ * whole file is discarded once it was written by another mruby.
+ *
+ * Besides the cache in the data directory, a read-only one shipped
+ * with the game (as produced by mkxp-scriptc) is consulted */
+struct ScriptCache
+{
+	std::string path;
+
+	BoostHash<uint64_t, std::string> entries;
+	size_t entryCount;
+
+	BoostHash<uint64_t, std::string> shipped;
+
+	/* Entries used during this run, to be written back */
+	std::vector<std::pair<uint64_t, std::string> > used;
+	bool dirty;
+
+	ScriptCache()
+	    : entryCount(0),
+	      dirty(false)
+	{}
+
+	/* 'kind' names the file, so differently sourced scripts of one
+	 * game (which would drop each other's entries) don't share one */
+	void init(const std::string &dataDir, const std::string &shippedPath,
+	          const char *kind = "scripts")
+	{
+		char buffer[1024];
+		std::string gameDir = getcwd(buffer, sizeof(buffer)) ? buffer : "";
+
+		char name[64];
+		snprintf(name, sizeof(name), "%.32s-%08x.mrbcache", kind, (uint32_t) hash(gameDir));
+		path = dataDir + name;
+
+		entryCount = read(path, entries);
+		read(shippedPath, shipped);
+	}
+
+	/* FNV-1a */
+	static uint64_t hash(const std::string &str, uint64_t value = 14695981039346656037ull)
+	{
+		for (size_t i = 0; i < str.size(); ++i)
+			value = (value ^ (uint8_t) str[i]) * 1099511628211ull;
+
+		return value;
+	}
+
+	/* Returns the bytecode for 'source', compiling it in 'mrb' if
+	 * needed. Empty if it doesn't compile; evaluating the source
+	 * directly will report the error */
+	std::string compile(mrb_state *mrb, const std::string &name, const std::string &source)
+	{
+		uint64_t key = hash(name, hash(source) ^ source.size());
+
+		BoostHash<uint64_t, std::string>::const_iterator iter = entries.find(key);
+
+		if (iter != entries.cend())
+		{
+			used.push_back(std::make_pair(key, iter->second));
+			return iter->second;
+		}
+
+		/* Shipped entries needn't be duplicated into our own cache */
+		iter = shipped.find(key);
+
+		if (iter != shipped.cend())
+			return iter->second;
+
+		std::string binary;
+
+		mrbc_context *ctx = mrbc_context_new(mrb);
+		ctx->capture_errors = 1;
+		mrbc_filename(mrb, ctx, name.c_str());
+
+		int ai = mrb_gc_arena_save(mrb);
+
+		mrb_parser_state *parser = mrb_parse_nstring(mrb, source.c_str(), source.size(), ctx);
+
+		if (parser && parser->nerr == 0)
+		{
+			RProc *proc = mrb_generate_code(mrb, parser);
+
+			uint8_t *bin;
+			size_t binSize;
+
+			if (proc && mrb_dump_irep(mrb, proc->body.irep, DUMP_DEBUG_INFO,
+			                          &bin, &binSize) == MRB_DUMP_OK)
+			{
+				binary.assign(reinterpret_cast<const char*>(bin), binSize);
+				mrb_free(mrb, bin);
+			}
+		}
+
+		if (parser)
+			mrb_parser_free(parser);
+
+		mrb_gc_arena_restore(mrb, ai);
+		mrbc_context_free(mrb, ctx);
+
+		if (!binary.empty())
+		{
+			used.push_back(std::make_pair(key, binary));
+			dirty = true;
+		}
+
+		return binary;
+	}
+
+	/* Serializes all used entries; this drops stale ones */
+	void write()
+	{
+		if (!dirty && used.size() == entryCount)
+			return;
+
+		writeFile(path);
+	}
+
+	/* Writes all used entries to 'filename', returns false on failure */
+	bool writeFile(const std::string &filename) const
+	{
+		FILE *f = fopen(filename.c_str(), "wb");
+
+		if (!f)
+			return false;
+
+		writeU64(f, SCRIPT_CACHE_VER);
+		writeString(f, MRUBY_VERSION);
+		writeU64(f, used.size());
+
+		for (size_t i = 0; i < used.size(); ++i)
+		{
+			writeU64(f, used[i].first);
+			writeString(f, used[i].second);
+		}
+
+		bool ok = !ferror(f);
+
+		return (fclose(f) == 0) && ok;
+	}
+
+private:
+	/* Returns the number of entries read */
+	static size_t read(const std::string &filename, BoostHash<uint64_t, std::string> &hash)
+	{
+		FILE *f = fopen(filename.c_str(), "rb");
+
+		if (!f)
+			return 0;
+
+		uint64_t ver, count;
+		std::string version;
+		size_t result = 0;
+
+		if (readU64(f, ver) && ver == SCRIPT_CACHE_VER
+		    && readString(f, version) && version == MRUBY_VERSION
+		    && readU64(f, count))
+		{
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				uint64_t key;
+				std::string binary;
+
+				if (!readU64(f, key) || !readString(f, binary))
+					break;
+
+				hash.insert(key, binary);
+				++result;
+			}
+		}
+
+		fclose(f);
+
+		return result;
+	}
+
+	static void writeU64(FILE *f, uint64_t value)
+	{
+		fwrite(&value, sizeof(value), 1, f);
+	}
+
+	static void writeString(FILE *f, const std::string &str)
+	{
+		writeU64(f, str.size());
+		fwrite(str.c_str(), 1, str.size(), f);
+	}
+
+	static bool readU64(FILE *f, uint64_t &value)
+	{
+		return fread(&value, sizeof(value), 1, f) == 1;
+	}
+
+	static bool readString(FILE *f, std::string &str)
+	{
+		uint64_t len;
+
+		/* Arbitrary max value */
+		if (!readU64(f, len) || len > 0x4000000)
+			return false;
+
+		str.resize(len);
+
+		return len == 0 || fread(&str[0], 1, len, f) == len;
+	}
+};
+
+#endif // SCRIPTCACHE_H
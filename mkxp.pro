@@ -99,6 +99,7 @@ HEADERS += \
 	src/sprite.h \
 	src/table.h \
 	src/texpool.h \
+	src/imagecache.h \
 	src/tilequad.h \
 	src/transform.h \
 	src/viewport.h \
@@ -114,6 +115,9 @@ HEADERS += \
 	src/global-ibo.h \
 	src/exception.h \
 	src/filesystem.h \
+	src/imagedecoder.h \
+	src/savewriter.h \
+	src/pathfinder.h \
 	src/serial-util.h \
 	src/intrulist.h \
 	src/binding.h \
@@ -148,6 +152,9 @@ SOURCES += \
 	src/bitmap.cpp \
 	src/eventthread.cpp \
 	src/filesystem.cpp \
+	src/imagedecoder.cpp \
+	src/savewriter.cpp \
+	src/pathfinder.cpp \
 	src/font.cpp \
 	src/input.cpp \
 	src/iniconfig.cpp \
@@ -159,6 +166,7 @@ SOURCES += \
 	src/viewport.cpp \
 	src/window.cpp \
 	src/texpool.cpp \
+	src/imagecache.cpp \
 	src/shader.cpp \
 	src/glstate.cpp \
 	src/tilemap.cpp \
@@ -197,6 +205,7 @@ EMBED = \
 	shader/plane.frag \
 	shader/gray.frag \
 	shader/bitmapBlit.frag \
+	shader/bitmapBlitFetch.frag \
 	shader/flatColor.frag \
 	shader/simple.frag \
 	shader/simpleColor.frag \
@@ -209,6 +218,7 @@ EMBED = \
 	shader/sprite.vert \
 	shader/tilemap.vert \
 	shader/blur.frag \
+	shader/radialBlur.frag \
 	shader/blurH.vert \
 	shader/blurV.vert \
 	shader/simpleMatrix.vert \
@@ -258,7 +268,8 @@ BINDING_MRUBY {
 	binding-mruby/serializable-binding.h \
 	binding-mruby/mrb-ext/file.h \
 	binding-mruby/mrb-ext/rwmem.h \
-	binding-mruby/mrb-ext/marshal.h
+	binding-mruby/mrb-ext/marshal.h \
+	binding-mruby/scriptcache.h
 
 	SOURCES += \
 	binding-mruby/binding-mruby.cpp \
@@ -325,6 +336,10 @@ BINDING_MRI {
 	binding-mri/audio-binding.cpp \
 	binding-mri/module_rpg.cpp \
 	binding-mri/filesystem-binding.cpp \
+	binding-mri/marshal-load.cpp \
+	binding-mri/rpgcache-binding.cpp \
+	binding-mri/pathfinder-binding.cpp \
+	binding-mri/profiler-binding.cpp \
 	binding-mri/windowvx-binding.cpp \
 	binding-mri/tilemapvx-binding.cpp
 }
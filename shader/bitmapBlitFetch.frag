@@ -0,0 +1,32 @@
+/* Variant of bitmapBlit.frag reading the destination
+ * directly from the framebuffer (EXT_shader_framebuffer_fetch),
+ * sparing the copy of the destination region */
+
+uniform sampler2D source;
+
+uniform lowp float opacity;
+
+varying vec2 v_texCoord;
+
+void main()
+{
+	vec4 srcFrag = texture2D(source, v_texCoord);
+#ifdef GL_EXT_shader_framebuffer_fetch
+	vec4 dstFrag = gl_LastFragData[0];
+#else
+	vec4 dstFrag = vec4(0.0);
+#endif
+
+	vec4 resFrag;
+
+	float co1 = srcFrag.a * opacity;
+	float co2 = dstFrag.a * (1.0 - co1);
+	resFrag.a = co1 + co2;
+
+	if (resFrag.a == 0.0)
+		resFrag.rgb = srcFrag.rgb;
+	else
+		resFrag.rgb = (co1*srcFrag.rgb + co2*dstFrag.rgb) / resFrag.a;
+
+	gl_FragColor = resFrag;
+}
@@ -0,0 +1,81 @@
+/* Single pass radial blur, equivalent to additively
+ * drawing the bitmap (plus its mirrored copies along
+ * each edge) 'samples' times, rotated around the center */
+
+uniform sampler2D texture;
+
+uniform vec2 bitmapSize;
+
+/* cos/sin of the first sample's angle
+ * and of the angle between two samples */
+uniform vec2 baseRot;
+uniform vec2 stepRot;
+
+uniform int samples;
+
+varying vec2 v_texCoord;
+
+/* Highest 'divisions' value accepted by radial_blur */
+#define MAX_SAMPLES 100
+
+void main()
+{
+	vec2 center = bitmapSize * 0.5;
+	vec2 delta = v_texCoord * bitmapSize - center;
+
+	/* Rotate back to the first sample's source position */
+	vec2 rel = vec2(baseRot.x * delta.x - baseRot.y * delta.y,
+	                baseRot.y * delta.x + baseRot.x * delta.y);
+
+	vec4 frag = vec4(0.0);
+
+	for (int i = 0; i < MAX_SAMPLES; ++i)
+	{
+		if (i >= samples)
+			break;
+
+		vec2 pos = center + rel;
+		rel = vec2(stepRot.x * rel.x - stepRot.y * rel.y,
+		           stepRot.y * rel.x + stepRot.x * rel.y);
+
+		/* Mirror across the edges; the diagonal
+		 * corner regions are left uncovered */
+		bool mirrorX = false, mirrorY = false;
+
+		if (pos.x < 0.0)
+		{
+			pos.x = -pos.x;
+			mirrorX = true;
+		}
+		else if (pos.x > bitmapSize.x)
+		{
+			pos.x = 2.0 * bitmapSize.x - pos.x;
+			mirrorX = true;
+		}
+
+		if (pos.y < 0.0)
+		{
+			pos.y = -pos.y;
+			mirrorY = true;
+		}
+		else if (pos.y > bitmapSize.y)
+		{
+			pos.y = 2.0 * bitmapSize.y - pos.y;
+			mirrorY = true;
+		}
+
+		/* Positions more than a bitmap size outside
+		 * still fall outside after mirroring */
+		if ((mirrorX && mirrorY) ||
+		    pos.x < 0.0 || pos.y < 0.0 ||
+		    pos.x > bitmapSize.x || pos.y > bitmapSize.y)
+			continue;
+
+		vec4 texel = texture2D(texture, pos / bitmapSize);
+
+		frag.rgb += texel.rgb * texel.a;
+		frag.a += texel.a;
+	}
+
+	gl_FragColor = frag / float(samples);
+}
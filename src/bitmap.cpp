@@ -41,12 +41,14 @@
 #include "texpool.h"
 #include "shader.h"
 #include "filesystem.h"
+#include "imagedecoder.h"
+#include "imagecache.h"
 #include "font.h"
 #include "eventthread.h"
 
 #define GUARD_MEGA \
 	{ \
-		if (p->megaSurface) \
+		if (p->isMega()) \
 			throw Exception(Exception::MKXPError, \
                             "Operation not supported for mega surfaces"); \
 	}
@@ -82,11 +84,17 @@ struct BitmapPrivate
 
 	Font *font;
 
-	/* "Mega surfaces" are a hack to allow Tilesets to be used
-	 * whose Bitmaps don't fit into a regular texture. They're
-	 * kept in RAM and will throw an error if they're used in
-	 * any context other than as Tilesets */
-	SDL_Surface *megaSurface;
+	/* Bitmaps that don't fit into a regular texture are split
+	 * into tiles of at most the maximum texture size, which
+	 * (most) operations are forwarded to. In this case, 'gl'
+	 * stays unallocated */
+	std::vector<Bitmap::Tile> tiles;
+	Vec2i megaSize;
+
+	/* Bitmaps loaded from image files start out sharing one
+	 * texture with all other Bitmaps of the same file. They
+	 * acquire their own copy before being modified */
+	SharedImage *shared;
 
 	/* A cached version of the bitmap in client memory, for
 	 * getPixel calls. Is invalidated any time the bitmap
@@ -102,21 +110,139 @@ struct BitmapPrivate
 	 * ourselves the expensive blending calculation */
 	pixman_region16_t tainted;
 
+	/* The 'opaque' area is a (conservative) subset of the
+	 * tainted area known to have full opacity. Blending onto
+	 * an opaque destination reduces the RGSS blend equation
+	 * to regular alpha blending, so we can render there
+	 * directly instead of sampling a copy of the destination */
+	pixman_region16_t opaque;
+
+	/* Fill operations aren't rendered right away, but collected
+	 * here and flushed as a single draw call as soon as the
+	 * bitmap's texture is accessed in any other way */
+	std::vector<Vertex> pendingFills;
+
 	BitmapPrivate(Bitmap *self)
 	    : self(self),
-	      megaSurface(0),
+	      shared(0),
 	      surface(0)
 	{
 		format = SDL_AllocFormat(SDL_PIXELFORMAT_ABGR8888);
 
 		font = &shState->defaultFont();
 		pixman_region_init(&tainted);
+		pixman_region_init(&opaque);
 	}
 
 	~BitmapPrivate()
 	{
 		SDL_FreeFormat(format);
 		pixman_region_fini(&tainted);
+		pixman_region_fini(&opaque);
+	}
+
+	bool isMega() const
+	{
+		return !tiles.empty();
+	}
+
+	void allocTiles(int width, int height)
+	{
+		const int tileSize = glState.caps.maxTexSize;
+
+		try
+		{
+			for (int y = 0; y < height; y += tileSize)
+				for (int x = 0; x < width; x += tileSize)
+				{
+					Bitmap::Tile tile;
+					tile.rect = IntRect(x, y, std::min(tileSize, width - x),
+					                    std::min(tileSize, height - y));
+					tile.bitmap = new Bitmap(tile.rect.w, tile.rect.h);
+
+					tiles.push_back(tile);
+				}
+		}
+		catch (const Exception &e)
+		{
+			freeTiles();
+			throw e;
+		}
+
+		megaSize = Vec2i(width, height);
+	}
+
+	void freeTiles()
+	{
+		for (size_t i = 0; i < tiles.size(); ++i)
+			delete tiles[i].bitmap;
+
+		tiles.clear();
+	}
+
+	/* Translates 'rect' into the coordinate space of 'tile'.
+	 * Returns false if the two don't intersect at all */
+	static bool toTileRect(const Bitmap::Tile &tile,
+	                       const IntRect &rect, IntRect &tileRect)
+	{
+		IntRect norm = normalizedRect(rect);
+		SDL_Rect inters;
+
+		if (!SDL_IntersectRect(&norm, &tile.rect, &inters))
+			return false;
+
+		tileRect = IntRect(rect.x - tile.rect.x, rect.y - tile.rect.y,
+		                   rect.w, rect.h);
+
+		return true;
+	}
+
+	Bitmap::Tile *findTile(int x, int y)
+	{
+		for (size_t i = 0; i < tiles.size(); ++i)
+		{
+			const IntRect &r = tiles[i].rect;
+
+			if (x >= r.x && y >= r.y && x < r.x+r.w && y < r.y+r.h)
+				return &tiles[i];
+		}
+
+		return 0;
+	}
+
+	/* Called before anything writes to 'gl' */
+	void unshare(bool keepContents = true)
+	{
+		if (!shared)
+			return;
+
+		TEXFBO own = shState->texPool().request(gl.width, gl.height);
+
+		if (keepContents)
+		{
+			GLMeta::blitBegin(own);
+			GLMeta::blitSource(gl);
+			GLMeta::blitRectangle(IntRect(0, 0, gl.width, gl.height), Vec2i());
+			GLMeta::blitEnd();
+		}
+
+		shState->imageCache().release(shared);
+		shared = 0;
+
+		gl = own;
+	}
+
+	void releaseTex()
+	{
+		if (shared)
+		{
+			shState->imageCache().release(shared);
+			shared = 0;
+		}
+		else
+		{
+			shState->texPool().release(gl);
+		}
 	}
 
 	void allocSurface()
@@ -130,6 +256,8 @@ struct BitmapPrivate
 	{
 		pixman_region_fini(&tainted);
 		pixman_region_init(&tainted);
+
+		clearOpaqueArea();
 	}
 
 	void addTaintedArea(const IntRect &rect)
@@ -150,6 +278,8 @@ struct BitmapPrivate
 		pixman_region_subtract(&tainted, &m_reg, &tainted);
 
 		pixman_region_fini(&m_reg);
+
+		substractOpaqueArea(rect);
 	}
 
 	bool touchesTaintedArea(const IntRect &rect)
@@ -166,6 +296,47 @@ struct BitmapPrivate
 		return result != PIXMAN_REGION_OUT;
 	}
 
+	void clearOpaqueArea()
+	{
+		pixman_region_fini(&opaque);
+		pixman_region_init(&opaque);
+	}
+
+	void addOpaqueArea(const IntRect &rect)
+	{
+		IntRect norm = normalizedRect(rect);
+		pixman_region_union_rect
+		        (&opaque, &opaque, norm.x, norm.y, norm.w, norm.h);
+	}
+
+	void substractOpaqueArea(const IntRect &rect)
+	{
+		IntRect norm = normalizedRect(rect);
+
+		pixman_region16_t m_reg;
+		pixman_region_init_rect(&m_reg, norm.x, norm.y, norm.w, norm.h);
+
+		pixman_region_subtract(&opaque, &opaque, &m_reg);
+
+		pixman_region_fini(&m_reg);
+	}
+
+	bool insideOpaqueArea(const IntRect &rect)
+	{
+		IntRect norm = normalizedRect(rect);
+
+		pixman_box16_t box;
+		box.x1 = norm.x;
+		box.y1 = norm.y;
+		box.x2 = norm.x + norm.w;
+		box.y2 = norm.y + norm.h;
+
+		pixman_region_overlap_t result =
+		        pixman_region_contains_rectangle(&opaque, &box);
+
+		return result == PIXMAN_REGION_IN;
+	}
+
 	void bindTexture(ShaderBase &shader)
 	{
 		TEX::bind(gl.tex);
@@ -195,20 +366,152 @@ struct BitmapPrivate
 		glState.blend.pop();
 	}
 
-	void fillRect(const IntRect &rect,
-	              const Vec4 &color)
+	void queueFill(const IntRect &rect,
+	               const Vec4 &color1, const Vec4 &color2,
+	               bool vertical)
 	{
-		bindFBO();
+		unshare();
+
+		size_t i = pendingFills.size();
+		pendingFills.resize(i + 4);
+
+		Vertex *vert = &pendingFills[i];
+		Quad::setPosRect(vert, rect);
+
+		if (vertical)
+		{
+			vert[0].color = color1;
+			vert[1].color = color1;
+			vert[2].color = color2;
+			vert[3].color = color2;
+		}
+		else
+		{
+			vert[0].color = color1;
+			vert[3].color = color1;
+			vert[1].color = color2;
+			vert[2].color = color2;
+		}
+	}
+
+	void queueFill(const IntRect &rect, const Vec4 &color)
+	{
+		queueFill(normalizedRect(rect), color, color, false);
+	}
+
+	void flushFills()
+	{
+		if (pendingFills.empty())
+			return;
+
+		/* We might get called in the middle of someone else's
+		 * draw setup (via getGLTypes() / bindTex()), so leave
+		 * framebuffer bindings and program as we found them */
+		GLint drawFBO, readFBO;
+
+		if (::gl.BlitFramebuffer)
+		{
+			::gl.GetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFBO);
+			::gl.GetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFBO);
+		}
+		else
+		{
+			::gl.GetIntegerv(GL_FRAMEBUFFER_BINDING, &drawFBO);
+		}
 
-		glState.scissorTest.pushSet(true);
-		glState.scissorBox.pushSet(normalizedRect(rect));
-		glState.clearColor.pushSet(color);
+		glState.program.push();
 
-		FBO::clear();
+		ColorQuadArray &qArray = shState->gpQuadArray();
+		qArray.vertices.swap(pendingFills);
+		qArray.quadCount = qArray.vertices.size() / 4;
+		qArray.commit();
+
+		pendingFills.clear();
+
+		SimpleColorShader &shader = shState->shaders().simpleColor;
+		shader.bind();
+		shader.setTranslation(Vec2i());
 
-		glState.clearColor.pop();
-		glState.scissorBox.pop();
+		bindFBO();
+		pushSetViewport(shader);
+
+		/* Fills replace the destination contents. A viewport's
+		 * scissor box (in screen coordinates) may still be active */
+		glState.blend.pushSet(false);
+		glState.scissorTest.pushSet(false);
+		qArray.draw();
 		glState.scissorTest.pop();
+		glState.blend.pop();
+
+		popViewport();
+
+		glState.program.pop();
+
+		if (::gl.BlitFramebuffer)
+		{
+			::gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+			::gl.BindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+		}
+		else
+		{
+			::gl.BindFramebuffer(GL_FRAMEBUFFER, drawFBO);
+		}
+	}
+
+	/* Draws 'quad', sampling the currently bound texture of size
+	 * 'texSize', onto 'destRect' using the RGSS blend equation,
+	 * without acquiring a copy of the destination first.
+	 * Returns false (drawing nothing) if this isn't possible */
+	bool blendQuadDirect(Quad &quad, const IntRect &destRect,
+	                     const Vec2i &texSize, float opacity)
+	{
+		if (!shState->config().directBlending)
+			return false;
+
+		if (insideOpaqueArea(destRect))
+		{
+			/* With a destination alpha of 1, the RGSS equation
+			 * equals regular blending with separate functions */
+			SimpleAlphaShader &shader = shState->shaders().simpleAlpha;
+			shader.bind();
+			shader.setTexSize(texSize);
+			shader.setTranslation(Vec2i());
+
+			quad.setColor(Vec4(1, 1, 1, opacity));
+
+			bindFBO();
+			pushSetViewport(shader);
+
+			glState.blendMode.pushSet(BlendNormal);
+			glState.blend.pushSet(true);
+			quad.draw();
+			glState.blend.pop();
+			glState.blendMode.pop();
+
+			popViewport();
+
+			return true;
+		}
+
+		if (::gl.fb_fetch)
+		{
+			BltFetchShader &shader = shState->shaders().bltFetch;
+			shader.bind();
+			shader.setSource();
+			shader.setTexSize(texSize);
+			shader.setOpacity(opacity);
+
+			bindFBO();
+			pushSetViewport(shader);
+
+			blitQuad(quad);
+
+			popViewport();
+
+			return true;
+		}
+
+		return false;
 	}
 
 	static void ensureFormat(SDL_Surface *&surf, Uint32 format)
@@ -233,6 +536,23 @@ struct BitmapPrivate
 	}
 };
 
+static bool isSurfaceOpaque(SDL_Surface *surf)
+{
+	const Uint32 aMask = surf->format->Amask;
+
+	for (int y = 0; y < surf->h; ++y)
+	{
+		const uint32_t *row =
+			(const uint32_t*) ((uint8_t*) surf->pixels + y*surf->pitch);
+
+		for (int x = 0; x < surf->w; ++x)
+			if ((row[x] & aMask) != aMask)
+				return false;
+	}
+
+	return true;
+}
+
 struct BitmapOpenHandler : FileSystem::OpenHandler
 {
 	SDL_Surface *surf;
@@ -250,22 +570,92 @@ struct BitmapOpenHandler : FileSystem::OpenHandler
 
 Bitmap::Bitmap(const char *filename)
 {
-	BitmapOpenHandler handler;
-	shState->fileSystem().openRead(handler, filename);
-	SDL_Surface *imgSurf = handler.surf;
+	FileSystem &fs = shState->fileSystem();
+
+	/* Textures are shared by the file they were loaded from, however
+	 * it was named, for as long as that file doesn't change */
+	std::string path = fs.resolvePath(filename);
+	uint64_t stamp = fs.fileStamp(path.c_str());
+
+	SharedImage *cached = shState->imageCache().acquire(path, stamp);
+
+	if (cached)
+	{
+		p = new BitmapPrivate(this);
+		p->gl = cached->gl;
+		p->shared = cached;
+
+		if (cached->opaque)
+			p->addOpaqueArea(rect());
+
+		p->addTaintedArea(rect());
+
+		return;
+	}
+
+	/* Pick up the image if it was preloaded */
+	SDL_Surface *imgSurf = shState->imageDecoder().take(filename);
 
 	if (!imgSurf)
-		throw Exception(Exception::SDLError, "Error loading image '%s': %s",
-		                filename, SDL_GetError());
+	{
+		BitmapOpenHandler handler;
+		std::string foundPath;
+		fs.openRead(handler, filename, &foundPath);
+		imgSurf = handler.surf;
+
+		if (!imgSurf)
+			throw Exception(Exception::SDLError, "Error loading image '%s': %s",
+			                filename, SDL_GetError());
+
+		/* The first candidate might not have been an image */
+		if (foundPath != path)
+		{
+			path = foundPath;
+			stamp = fs.fileStamp(path.c_str());
+		}
+	}
 
 	p->ensureFormat(imgSurf, SDL_PIXELFORMAT_ABGR8888);
 
 	if (imgSurf->w > glState.caps.maxTexSize || imgSurf->h > glState.caps.maxTexSize)
 	{
-		/* Mega surface */
+		/* Mega bitmap */
 		p = new BitmapPrivate(this);
-		p->megaSurface = imgSurf;
-		SDL_SetSurfaceBlendMode(p->megaSurface, SDL_BLENDMODE_NONE);
+
+		try
+		{
+			p->allocTiles(imgSurf->w, imgSurf->h);
+		}
+		catch (const Exception &e)
+		{
+			delete p;
+			SDL_FreeSurface(imgSurf);
+			throw e;
+		}
+
+		const bool opaque = isSurfaceOpaque(imgSurf);
+
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			const IntRect &tileRect = p->tiles[i].rect;
+			BitmapPrivate *tp = p->tiles[i].bitmap->p;
+
+			/* The initial clear is overwritten anyway */
+			tp->pendingFills.clear();
+
+			TEX::bind(tp->gl.tex);
+			GLMeta::subRectImageUpload(imgSurf->w, tileRect.x, tileRect.y,
+			                           0, 0, tileRect.w, tileRect.h, imgSurf, GL_RGBA);
+
+			tp->addTaintedArea(IntRect(0, 0, tileRect.w, tileRect.h));
+
+			if (opaque)
+				tp->addOpaqueArea(IntRect(0, 0, tileRect.w, tileRect.h));
+		}
+
+		GLMeta::subRectImageEnd();
+
+		SDL_FreeSurface(imgSurf);
 	}
 	else
 	{
@@ -288,6 +678,13 @@ Bitmap::Bitmap(const char *filename)
 		TEX::bind(p->gl.tex);
 		TEX::uploadImage(p->gl.width, p->gl.height, imgSurf->pixels, GL_RGBA);
 
+		const bool opaque = isSurfaceOpaque(imgSurf);
+
+		if (opaque)
+			p->addOpaqueArea(rect());
+
+		p->shared = shState->imageCache().insert(path, stamp, p->gl, opaque);
+
 		SDL_FreeSurface(imgSurf);
 	}
 
@@ -299,6 +696,25 @@ Bitmap::Bitmap(int width, int height)
 	if (width <= 0 || height <= 0)
 		throw Exception(Exception::RGSSError, "failed to create bitmap");
 
+	if (width > glState.caps.maxTexSize || height > glState.caps.maxTexSize)
+	{
+		/* Mega bitmap */
+		p = new BitmapPrivate(this);
+
+		try
+		{
+			p->allocTiles(width, height);
+		}
+		catch (const Exception &e)
+		{
+			delete p;
+			throw e;
+		}
+
+		/* Tiles start out cleared */
+		return;
+	}
+
 	TEXFBO tex = shState->texPool().request(width, height);
 
 	p = new BitmapPrivate(this);
@@ -309,13 +725,51 @@ Bitmap::Bitmap(int width, int height)
 
 Bitmap::Bitmap(const Bitmap &other)
 {
-	other.ensureNonMega();
-
 	p = new BitmapPrivate(this);
 
+	if (other.isMega())
+	{
+		try
+		{
+			p->allocTiles(other.width(), other.height());
+		}
+		catch (const Exception &e)
+		{
+			delete p;
+			throw e;
+		}
+
+		/* Both are split up the same way */
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			Bitmap *tile = p->tiles[i].bitmap;
+			Bitmap *otherTile = other.p->tiles[i].bitmap;
+
+			tile->blt(0, 0, *otherTile, otherTile->rect());
+			pixman_region_copy(&tile->p->opaque, &otherTile->p->opaque);
+		}
+
+		return;
+	}
+
+	if (other.p->shared)
+	{
+		/* Unmodified image, keep sharing it */
+		p->gl = other.p->gl;
+		p->shared = other.p->shared;
+		shState->imageCache().addRef(p->shared);
+
+		pixman_region_copy(&p->tainted, &other.p->tainted);
+		pixman_region_copy(&p->opaque, &other.p->opaque);
+
+		return;
+	}
+
 	p->gl = shState->texPool().request(other.width(), other.height());
 
 	blt(0, 0, other, rect());
+
+	pixman_region_copy(&p->opaque, &other.p->opaque);
 }
 
 Bitmap::~Bitmap()
@@ -323,12 +777,40 @@ Bitmap::~Bitmap()
 	dispose();
 }
 
+void Bitmap::preload(const char *filename)
+{
+	shState->imageDecoder().preload(filename);
+}
+
+bool Bitmap::isCached(const char *filename)
+{
+	FileSystem &fs = shState->fileSystem();
+	std::string path;
+
+	try
+	{
+		path = fs.resolvePath(filename);
+	}
+	catch (const Exception &)
+	{
+		/* Loading it will report the error */
+		return false;
+	}
+
+	return shState->imageCache().contains(path, fs.fileStamp(path.c_str()));
+}
+
+bool Bitmap::decode(const char *filename)
+{
+	return shState->imageDecoder().decode(filename);
+}
+
 int Bitmap::width() const
 {
 	guardDisposed();
 
-	if (p->megaSurface)
-		return p->megaSurface->w;
+	if (p->isMega())
+		return p->megaSize.x;
 
 	return p->gl.width;
 }
@@ -337,8 +819,8 @@ int Bitmap::height() const
 {
 	guardDisposed();
 
-	if (p->megaSurface)
-		return p->megaSurface->h;
+	if (p->isMega())
+		return p->megaSize.y;
 
 	return p->gl.height;
 }
@@ -373,14 +855,41 @@ void Bitmap::blt(int x, int y,
 	           source, rect, opacity);
 }
 
+/* Maps the part [interPos, interPos+interLen) of the (possibly
+ * inverted) source span onto the corresponding destination span.
+ * Both ends are rounded the same way for every part, so adjacent
+ * parts meet without gaps or overlap */
+static void mapTileAxis(int srcPos, int srcLen, int dstPos, int dstLen,
+                        int interPos, int interLen,
+                        int &subSrcPos, int &subSrcLen,
+                        int &subDstPos, int &subDstLen)
+{
+	if (srcLen > 0)
+	{
+		subSrcPos = interPos;
+		subSrcLen = interLen;
+	}
+	else
+	{
+		subSrcPos = interPos + interLen;
+		subSrcLen = -interLen;
+	}
+
+	const float scale = (float) dstLen / srcLen;
+
+	int start = dstPos + lroundf((subSrcPos - srcPos) * scale);
+	int end   = dstPos + lroundf((subSrcPos + subSrcLen - srcPos) * scale);
+
+	subDstPos = start;
+	subDstLen = end - start;
+}
+
 void Bitmap::stretchBlt(const IntRect &destRect,
                         const Bitmap &source, const IntRect &sourceRect,
                         int opacity)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	if (source.isDisposed())
 		return;
 
@@ -389,86 +898,55 @@ void Bitmap::stretchBlt(const IntRect &destRect,
 	if (opacity == 0)
 		return;
 
-	SDL_Surface *srcSurf = source.megaSurface();
-
-	if (srcSurf && shState->config().subImageFix)
+	if (p->isMega())
 	{
-		/* Blit from software surface, for broken GL drivers */
-		Vec2i gpTexSize;
-		shState->ensureTexSize(sourceRect.w, sourceRect.h, gpTexSize);
-		shState->bindTex();
-
-		GLMeta::subRectImageUpload(srcSurf->w, sourceRect.x, sourceRect.y, 0, 0,
-		                           sourceRect.w, sourceRect.h, srcSurf, GL_RGBA);
-		GLMeta::subRectImageEnd();
-
-		SimpleShader &shader = shState->shaders().simple;
-		shader.bind();
-		shader.setTranslation(Vec2i());
-		shader.setTexSize(gpTexSize);
-
-		p->pushSetViewport(shader);
-		p->bindFBO();
-
-		Quad &quad = shState->gpQuad();
-		quad.setTexRect(FloatRect(0, 0, sourceRect.w, sourceRect.h));
-		quad.setPosRect(destRect);
+		/* Let every affected tile draw its part */
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			IntRect tileRect;
 
-		p->blitQuad(quad);
-		p->popViewport();
+			if (BitmapPrivate::toTileRect(p->tiles[i], destRect, tileRect))
+				p->tiles[i].bitmap->stretchBlt(tileRect, source, sourceRect, opacity);
+		}
 
-		p->addTaintedArea(destRect);
 		p->onModified();
-
 		return;
 	}
-	else if (srcSurf)
+
+	if (source.isMega())
 	{
-		/* Blit from software surface */
-		/* Don't do transparent blits for now */
-		if (opacity < 255)
-			source.ensureNonMega();
+		/* Split the blit along the source's tile borders */
+		const IntRect srcNorm = normalizedRect(sourceRect);
 
-		SDL_Rect srcRect = sourceRect;
-		SDL_Rect dstRect = destRect;
-		SDL_Rect btmRect = { 0, 0, width(), height() };
-		SDL_Rect bltRect;
+		for (size_t i = 0; i < source.p->tiles.size(); ++i)
+		{
+			const Tile &tile = source.p->tiles[i];
+			SDL_Rect inters;
 
-		if (SDL_IntersectRect(&btmRect, &dstRect, &bltRect) != SDL_TRUE)
-			return;
+			if (!SDL_IntersectRect(&srcNorm, &tile.rect, &inters))
+				continue;
 
-		int bpp;
-		Uint32 rMask, gMask, bMask, aMask;
-		SDL_PixelFormatEnumToMasks(SDL_PIXELFORMAT_ABGR8888,
-		                           &bpp, &rMask, &gMask, &bMask, &aMask);
-		SDL_Surface *blitTemp =
-			SDL_CreateRGBSurface(0, destRect.w, destRect.h, bpp, rMask, gMask, bMask, aMask);
+			IntRect subSrc, subDst;
 
-		SDL_BlitScaled(srcSurf, &srcRect, blitTemp, 0);
+			mapTileAxis(sourceRect.x, sourceRect.w, destRect.x, destRect.w,
+			            inters.x, inters.w, subSrc.x, subSrc.w, subDst.x, subDst.w);
+			mapTileAxis(sourceRect.y, sourceRect.h, destRect.y, destRect.h,
+			            inters.y, inters.h, subSrc.y, subSrc.h, subDst.y, subDst.h);
 
-		TEX::bind(p->gl.tex);
+			subSrc.x -= tile.rect.x;
+			subSrc.y -= tile.rect.y;
 
-		if (bltRect.w == dstRect.w && bltRect.h == dstRect.h)
-		{
-			/* Dest rectangle lies within bounding box */
-			TEX::uploadSubImage(destRect.x, destRect.y,
-			                    destRect.w, destRect.h,
-			                    blitTemp->pixels, GL_RGBA);
+			stretchBlt(subDst, *tile.bitmap, subSrc, opacity);
 		}
-		else
-		{
-			/* Clipped blit */
-			GLMeta::subRectImageUpload(blitTemp->w, bltRect.x - dstRect.x, bltRect.y - dstRect.y,
-			                           bltRect.x, bltRect.y, bltRect.w, bltRect.h, blitTemp, GL_RGBA);
-			GLMeta::subRectImageEnd();
-		}
-
-		SDL_FreeSurface(blitTemp);
 
-		p->onModified();
 		return;
 	}
 
+	p->unshare();
+
+	p->flushFills();
+	source.p->flushFills();
+
 	if (opacity == 255 && !p->touchesTaintedArea(destRect))
 	{
 		/* Fast blit */
@@ -482,35 +960,45 @@ void Bitmap::stretchBlt(const IntRect &destRect,
 		/* Fragment pipeline */
 		float normOpacity = (float) opacity / 255.0f;
 
-		TEXFBO &gpTex = shState->gpTexFBO(destRect.w, destRect.h);
+		Quad &quad = shState->gpQuad();
+		quad.setTexPosRect(sourceRect, destRect);
 
-		GLMeta::blitBegin(gpTex);
-		GLMeta::blitSource(p->gl);
-		GLMeta::blitRectangle(destRect, Vec2i());
-		GLMeta::blitEnd();
+		TEX::bind(source.p->gl.tex);
 
-		FloatRect bltSubRect((float) sourceRect.x / source.width(),
-		                     (float) sourceRect.y / source.height(),
-		                     ((float) source.width() / sourceRect.w) * ((float) destRect.w / gpTex.width),
-		                     ((float) source.height() / sourceRect.h) * ((float) destRect.h / gpTex.height));
+		if (!p->blendQuadDirect(quad, destRect,
+		                        Vec2i(source.p->gl.width, source.p->gl.height),
+		                        normOpacity))
+		{
+			TEXFBO &gpTex = shState->gpTexFBO(destRect.w, destRect.h);
 
-		BltShader &shader = shState->shaders().blt;
-		shader.bind();
-		shader.setDestination(gpTex.tex);
-		shader.setSubRect(bltSubRect);
-		shader.setOpacity(normOpacity);
+			GLMeta::blitBegin(gpTex);
+			GLMeta::blitSource(p->gl);
+			GLMeta::blitRectangle(destRect, Vec2i());
+			GLMeta::blitEnd();
 
-		Quad &quad = shState->gpQuad();
-		quad.setTexPosRect(sourceRect, destRect);
-		quad.setColor(Vec4(1, 1, 1, normOpacity));
+			FloatRect bltSubRect((float) sourceRect.x / source.width(),
+			                     (float) sourceRect.y / source.height(),
+			                     ((float) source.width() / sourceRect.w) * ((float) destRect.w / gpTex.width),
+			                     ((float) source.height() / sourceRect.h) * ((float) destRect.h / gpTex.height));
+
+			BltShader &shader = shState->shaders().blt;
+			shader.bind();
+			shader.setDestination(gpTex.tex);
+			shader.setSubRect(bltSubRect);
+			shader.setOpacity(normOpacity);
 
-		source.p->bindTexture(shader);
-		p->bindFBO();
-		p->pushSetViewport(shader);
+			/* The destination copy might have used gpQuad */
+			quad.setTexPosRect(sourceRect, destRect);
+			quad.setColor(Vec4(1, 1, 1, normOpacity));
 
-		p->blitQuad(quad);
+			source.p->bindTexture(shader);
+			p->bindFBO();
+			p->pushSetViewport(shader);
 
-		p->popViewport();
+			p->blitQuad(quad);
+
+			p->popViewport();
+		}
 	}
 
 	p->addTaintedArea(destRect);
@@ -528,9 +1016,21 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			IntRect tileRect;
+
+			if (BitmapPrivate::toTileRect(p->tiles[i], rect, tileRect))
+				p->tiles[i].bitmap->fillRect(tileRect, color);
+		}
+
+		p->onModified();
+		return;
+	}
 
-	p->fillRect(rect, color);
+	p->queueFill(rect, color);
 
 	if (color.w == 0)
 		/* Clear op */
@@ -539,6 +1039,11 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
 		/* Fill op */
 		p->addTaintedArea(rect);
 
+	if (color.w == 1)
+		p->addOpaqueArea(rect);
+	else
+		p->substractOpaqueArea(rect);
+
 	p->onModified();
 }
 
@@ -556,40 +1061,30 @@ void Bitmap::gradientFillRect(const IntRect &rect,
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
-	SimpleColorShader &shader = shState->shaders().simpleColor;
-	shader.bind();
-	shader.setTranslation(Vec2i());
-
-	Quad &quad = shState->gpQuad();
-
-	if (vertical)
-	{
-		quad.vert[0].color = color1;
-		quad.vert[1].color = color1;
-		quad.vert[2].color = color2;
-		quad.vert[3].color = color2;
-	}
-	else
+	if (p->isMega())
 	{
-		quad.vert[0].color = color1;
-		quad.vert[3].color = color1;
-		quad.vert[1].color = color2;
-		quad.vert[2].color = color2;
-	}
-
-	quad.setPosRect(rect);
+		/* Parts of the gradient outside a tile are simply clipped */
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			IntRect tileRect;
 
-	p->bindFBO();
-	p->pushSetViewport(shader);
+			if (BitmapPrivate::toTileRect(p->tiles[i], rect, tileRect))
+				p->tiles[i].bitmap->gradientFillRect(tileRect, color1, color2, vertical);
+		}
 
-	p->blitQuad(quad);
+		p->onModified();
+		return;
+	}
 
-	p->popViewport();
+	p->queueFill(rect, color1, color2, vertical);
 
 	p->addTaintedArea(rect);
 
+	if (color1.w == 1 && color2.w == 1)
+		p->addOpaqueArea(rect);
+	else
+		p->substractOpaqueArea(rect);
+
 	p->onModified();
 }
 
@@ -602,9 +1097,88 @@ void Bitmap::clearRect(const IntRect &rect)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			IntRect tileRect;
+
+			if (BitmapPrivate::toTileRect(p->tiles[i], rect, tileRect))
+				p->tiles[i].bitmap->clearRect(tileRect);
+		}
+
+		p->onModified();
+		return;
+	}
+
+	p->queueFill(rect, Vec4());
+
+	p->substractOpaqueArea(rect);
+
+	p->onModified();
+}
+
+void Bitmap::fillRects(const std::vector<FillOp> &ops)
+{
+	guardDisposed();
+
+	if (ops.empty())
+		return;
+
+	if (p->isMega())
+	{
+		std::vector<FillOp> tileOps;
+
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			tileOps.clear();
+
+			for (size_t j = 0; j < ops.size(); ++j)
+			{
+				FillOp op = ops[j];
+
+				if (BitmapPrivate::toTileRect(p->tiles[i], ops[j].rect, op.rect))
+					tileOps.push_back(op);
+			}
 
-	p->fillRect(rect, Vec4());
+			if (!tileOps.empty())
+				p->tiles[i].bitmap->fillRects(tileOps);
+		}
+
+		p->onModified();
+		return;
+	}
+
+	for (size_t i = 0; i < ops.size(); ++i)
+	{
+		const FillOp &op = ops[i];
+
+		if (op.gradient)
+		{
+			p->queueFill(op.rect, op.color1, op.color2, op.vertical);
+
+			p->addTaintedArea(op.rect);
+
+			if (op.color1.w == 1 && op.color2.w == 1)
+				p->addOpaqueArea(op.rect);
+			else
+				p->substractOpaqueArea(op.rect);
+		}
+		else
+		{
+			p->queueFill(op.rect, op.color1);
+
+			if (op.color1.w == 0)
+				p->substractTaintedArea(op.rect);
+			else
+				p->addTaintedArea(op.rect);
+
+			if (op.color1.w == 1)
+				p->addOpaqueArea(op.rect);
+			else
+				p->substractOpaqueArea(op.rect);
+		}
+	}
 
 	p->onModified();
 }
@@ -615,6 +1189,10 @@ void Bitmap::blur()
 
 	GUARD_MEGA;
 
+	p->unshare();
+
+	p->flushFills();
+
 	Quad &quad = shState->gpQuad();
 	FloatRect rect(0, 0, width(), height());
 	quad.setTexPosRect(rect, rect);
@@ -651,6 +1229,9 @@ void Bitmap::blur()
 
 	shState->texPool().release(auxTex);
 
+	/* Edges of opaque areas might have been blurred */
+	p->clearOpaqueArea();
+
 	p->onModified();
 }
 
@@ -660,92 +1241,58 @@ void Bitmap::radialBlur(int angle, int divisions)
 
 	GUARD_MEGA;
 
+	p->flushFills();
+
 	angle     = clamp<int>(angle, 0, 359);
 	divisions = clamp<int>(divisions, 2, 100);
 
-	const int _width = width();
-	const int _height = height();
-
-	float angleStep = (float) angle / (divisions-1);
-	float opacity   = 1.0f / divisions;
-	float baseAngle = -((float) angle / 2);
-
-	ColorQuadArray qArray;
-	qArray.resize(5);
-
-	std::vector<Vertex> &vert = qArray.vertices;
-
-	int i = 0;
-
-	/* Center */
-	FloatRect texRect(0, 0, _width, _height);
-	FloatRect posRect(0, 0, _width, _height);
-
-	i += Quad::setTexPosRect(&vert[i*4], texRect, posRect);
+	/* Optionally spread fewer samples over the same arc */
+	int samples = divisions;
+	const int maxSamples = shState->config().radialBlurMaxSamples;
 
-	/* Upper */
-	posRect = FloatRect(0, 0, _width, -_height);
+	if (maxSamples > 0)
+		samples = clamp<int>(samples, 2, std::max(maxSamples, 2));
 
-	i += Quad::setTexPosRect(&vert[i*4], texRect, posRect);
-
-	/* Lower */
-	posRect = FloatRect(0, _height*2, _width, -_height);
-
-	i += Quad::setTexPosRect(&vert[i*4], texRect, posRect);
-
-	/* Left */
-	posRect = FloatRect(0, 0, -_width, _height);
-
-	i += Quad::setTexPosRect(&vert[i*4], texRect, posRect);
-
-	/* Right */
-	posRect = FloatRect(_width*2, 0, -_width, _height);
-
-	i += Quad::setTexPosRect(&vert[i*4], texRect, posRect);
-
-	for (int i = 0; i < 4*5; ++i)
-		vert[i].color = Vec4(1, 1, 1, opacity);
+	const int _width = width();
+	const int _height = height();
 
-	qArray.commit();
+	/* Degrees to radians, see Transform */
+	const float angleStep = ((float) angle / (samples-1)) * (M_PI / 180.0f);
+	const float baseAngle = -((float) angle / 2) * (M_PI / 180.0f);
 
 	TEXFBO newTex = shState->texPool().request(_width, _height);
 
 	FBO::bind(newTex.fbo);
 
-	glState.clearColor.pushSet(Vec4());
-	FBO::clear();
-
-	Transform trans;
-	trans.setOrigin(Vec2(_width / 2.0f, _height / 2.0f));
-	trans.setPosition(Vec2(_width / 2.0f, _height / 2.0f));
-
-	glState.blendMode.pushSet(BlendAddition);
+	glState.blend.pushSet(false);
 
-	SimpleMatrixShader &shader = shState->shaders().simpleMatrix;
+	RadialBlurShader &shader = shState->shaders().radialBlur;
 	shader.bind();
+	shader.setBitmapSize(Vec2(_width, _height));
+	shader.setRotation(baseAngle, angleStep);
+	shader.setSamples(samples);
 
 	p->bindTexture(shader);
 	TEX::setSmooth(true);
 
 	p->pushSetViewport(shader);
 
-	for (int i = 0; i < divisions; ++i)
-	{
-		trans.setRotation(baseAngle + i*angleStep);
-		shader.setMatrix(trans.getMatrix());
-		qArray.draw();
-	}
+	Quad &quad = shState->gpQuad();
+	quad.setTexPosRect(IntRect(0, 0, _width, _height),
+	                   IntRect(0, 0, _width, _height));
+	quad.draw();
 
 	p->popViewport();
 
 	TEX::setSmooth(false);
 
-	glState.blendMode.pop();
-	glState.clearColor.pop();
+	glState.blend.pop();
 
-	shState->texPool().release(p->gl);
+	p->releaseTex();
 	p->gl = newTex;
 
+	p->clearOpaqueArea();
+
 	p->onModified();
 }
 
@@ -753,7 +1300,18 @@ void Bitmap::clear()
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+			p->tiles[i].bitmap->clear();
+
+		p->onModified();
+		return;
+	}
+
+	/* Any pending fills would be overwritten anyway */
+	p->pendingFills.clear();
+	p->unshare(false);
 
 	p->bindFBO();
 
@@ -780,13 +1338,19 @@ Color Bitmap::getPixel(int x, int y) const
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	if (x < 0 || y < 0 || x >= width() || y >= height())
 		return Vec4();
 
+	if (p->isMega())
+	{
+		const Tile *tile = p->findTile(x, y);
+
+		return tile->bitmap->getPixel(x - tile->rect.x, y - tile->rect.y);
+	}
+
 	if (!p->surface)
 	{
+		p->flushFills();
 		p->allocSurface();
 
 		FBO::bind(p->gl.fbo);
@@ -810,7 +1374,18 @@ void Bitmap::setPixel(int x, int y, const Color &color)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		Tile *tile = p->findTile(x, y);
+
+		if (tile)
+		{
+			tile->bitmap->setPixel(x - tile->rect.x, y - tile->rect.y, color);
+			p->onModified();
+		}
+
+		return;
+	}
 
 	uint8_t pixel[] =
 	{
@@ -820,11 +1395,18 @@ void Bitmap::setPixel(int x, int y, const Color &color)
 		(uint8_t) clamp<double>(color.alpha, 0, 255)
 	};
 
+	p->unshare();
+
+	p->flushFills();
+
 	TEX::bind(p->gl.tex);
 	TEX::uploadSubImage(x, y, 1, 1, &pixel, GL_RGBA);
 
 	p->addTaintedArea(IntRect(x, y, 1, 1));
 
+	if (pixel[3] != 255)
+		p->substractOpaqueArea(IntRect(x, y, 1, 1));
+
 	/* Setting just a single pixel is no reason to throw away the
 	 * whole cached surface; we can just apply the same change */
 
@@ -841,11 +1423,20 @@ void Bitmap::hueChange(int hue)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	if ((hue % 360) == 0)
 		return;
 
+	if (p->isMega())
+	{
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+			p->tiles[i].bitmap->hueChange(hue);
+
+		p->onModified();
+		return;
+	}
+
+	p->flushFills();
+
 	TEXFBO newTex = shState->texPool().request(width(), height());
 
 	FloatRect texRect(rect());
@@ -869,7 +1460,7 @@ void Bitmap::hueChange(int hue)
 
 	TEX::unbind();
 
-	shState->texPool().release(p->gl);
+	p->releaseTex();
 	p->gl = newTex;
 
 	p->onModified();
@@ -988,7 +1579,29 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		/* Vertically centered text may overflow 'rect' */
+		const int textH = textSize(str).h + OUTLINE_SIZE*2;
+		const IntRect textArea(rect.x - OUTLINE_SIZE, rect.y - textH,
+		                       rect.w + OUTLINE_SIZE*2, rect.h + textH*2);
+
+		for (size_t i = 0; i < p->tiles.size(); ++i)
+		{
+			const Tile &tile = p->tiles[i];
+			IntRect tileArea;
+
+			if (!BitmapPrivate::toTileRect(tile, textArea, tileArea))
+				continue;
+
+			tile.bitmap->setInitFont(p->font);
+			tile.bitmap->drawText(IntRect(rect.x - tile.rect.x, rect.y - tile.rect.y,
+			                              rect.w, rect.h), str, align);
+		}
+
+		p->onModified();
+		return;
+	}
 
 	std::string fixed = fixupString(str);
 	str = fixed.c_str();
@@ -999,6 +1612,10 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 	if (str[0] == ' ' && str[1] == '\0')
 		return;
 
+	p->unshare();
+
+	p->flushFills();
+
 	TTF_Font *font = p->font->getSdlFont();
 	const Color &fontColor = p->font->getColor();
 	const Color &outColor = p->font->getOutColor();
@@ -1158,27 +1775,6 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 	}
 	else
 	{
-		/* Aquire a partial copy of the destination
-		 * buffer we're about to render to */
-		TEXFBO &gpTex2 = shState->gpTexFBO(posRect.w, posRect.h);
-
-		GLMeta::blitBegin(gpTex2);
-		GLMeta::blitSource(p->gl);
-		GLMeta::blitRectangle(posRect, Vec2i());
-		GLMeta::blitEnd();
-
-		FloatRect bltRect(0, 0,
-		                  (float) (gpTexSize.x * squeeze) / gpTex2.width,
-		                  (float) gpTexSize.y / gpTex2.height);
-
-		BltShader &shader = shState->shaders().blt;
-		shader.bind();
-		shader.setTexSize(gpTexSize);
-		shader.setSource();
-		shader.setDestination(gpTex2.tex);
-		shader.setSubRect(bltRect);
-		shader.setOpacity(txtAlpha);
-
 		shState->bindTex();
 		TEX::uploadSubImage(0, 0, txtSurf->w, txtSurf->h, txtSurf->pixels, GL_RGBA);
 		TEX::setSmooth(true);
@@ -1187,12 +1783,42 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 		quad.setTexRect(FloatRect(0, 0, txtSurf->w, txtSurf->h));
 		quad.setPosRect(posRect);
 
-		p->bindFBO();
-		p->pushSetViewport(shader);
+		if (!p->blendQuadDirect(quad, posRect, gpTexSize, txtAlpha))
+		{
+			/* Aquire a partial copy of the destination
+			 * buffer we're about to render to */
+			TEXFBO &gpTex2 = shState->gpTexFBO(posRect.w, posRect.h);
+
+			GLMeta::blitBegin(gpTex2);
+			GLMeta::blitSource(p->gl);
+			GLMeta::blitRectangle(posRect, Vec2i());
+			GLMeta::blitEnd();
+
+			FloatRect bltRect(0, 0,
+			                  (float) (gpTexSize.x * squeeze) / gpTex2.width,
+			                  (float) gpTexSize.y / gpTex2.height);
+
+			BltShader &shader = shState->shaders().blt;
+			shader.bind();
+			shader.setTexSize(gpTexSize);
+			shader.setSource();
+			shader.setDestination(gpTex2.tex);
+			shader.setSubRect(bltRect);
+			shader.setOpacity(txtAlpha);
+
+			/* The destination copy might have used gpQuad
+			 * and the texture binding */
+			shState->bindTex();
+			quad.setTexRect(FloatRect(0, 0, txtSurf->w, txtSurf->h));
+			quad.setPosRect(posRect);
+
+			p->bindFBO();
+			p->pushSetViewport(shader);
 
-		p->blitQuad(quad);
+			p->blitQuad(quad);
 
-		p->popViewport();
+			p->popViewport();
+		}
 	}
 
 	SDL_FreeSurface(txtSurf);
@@ -1249,8 +1875,6 @@ IntRect Bitmap::textSize(const char *str)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	TTF_Font *font = p->font->getSdlFont();
 
 	std::string fixed = fixupString(str);
@@ -1285,12 +1909,19 @@ void Bitmap::setInitFont(Font *value)
 
 TEXFBO &Bitmap::getGLTypes()
 {
+	p->flushFills();
+
 	return p->gl;
 }
 
-SDL_Surface *Bitmap::megaSurface() const
+bool Bitmap::isMega() const
+{
+	return p->isMega();
+}
+
+const std::vector<Bitmap::Tile> &Bitmap::getTiles() const
 {
-	return p->megaSurface;
+	return p->tiles;
 }
 
 void Bitmap::ensureNonMega() const
@@ -1303,20 +1934,22 @@ void Bitmap::ensureNonMega() const
 
 void Bitmap::bindTex(ShaderBase &shader)
 {
+	p->flushFills();
 	p->bindTexture(shader);
 }
 
 void Bitmap::taintArea(const IntRect &rect)
 {
 	p->addTaintedArea(rect);
+	p->substractOpaqueArea(rect);
 }
 
 void Bitmap::releaseResources()
 {
-	if (p->megaSurface)
-		SDL_FreeSurface(p->megaSurface);
+	if (p->isMega())
+		p->freeTiles();
 	else
-		shState->texPool().release(p->gl);
+		p->releaseTex();
 
 	delete p;
 }
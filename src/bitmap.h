@@ -28,10 +28,11 @@
 
 #include <sigc++/signal.h>
 
+#include <vector>
+
 class Font;
 class ShaderBase;
 struct TEXFBO;
-struct SDL_Surface;
 
 struct BitmapPrivate;
 // FIXME make this class use proper RGSS classes again
@@ -44,6 +45,18 @@ public:
 	Bitmap(const Bitmap &other);
 	~Bitmap();
 
+	/* Starts decoding 'filename' in the background, so a
+	 * later Bitmap(filename) only has to upload it */
+	static void preload(const char *filename);
+
+	/* Whether Bitmap(filename) can reuse an already uploaded texture */
+	static bool isCached(const char *filename);
+
+	/* Decodes 'filename' on the calling thread (which doesn't have
+	 * to be the RGSS thread), so a later Bitmap(filename) only has
+	 * to upload it. Returns false if it couldn't be decoded */
+	static bool decode(const char *filename);
+
 	int width()  const;
 	int height() const;
 	IntRect rect() const;
@@ -69,6 +82,23 @@ public:
 	                      const Vec4 &color1, const Vec4 &color2,
 	                      bool vertical = false);
 
+	/* A single (gradient) fill for batched use */
+	struct FillOp
+	{
+		IntRect rect;
+		Vec4 color1, color2;
+		bool gradient;
+		bool vertical;
+
+		FillOp()
+		    : gradient(false),
+		      vertical(false)
+		{}
+	};
+
+	/* Performs all fills in order, with a single draw call */
+	void fillRects(const std::vector<FillOp> &ops);
+
 	void clearRect(int x, int y,
 	               int width, int height);
 	void clearRect(const IntRect &rect);
@@ -107,7 +137,20 @@ public:
 
 	/* <internal> */
 	TEXFBO &getGLTypes();
-	SDL_Surface *megaSurface() const;
+
+	/* A regular bitmap covering part of a mega bitmap */
+	struct Tile
+	{
+		Bitmap *bitmap;
+		IntRect rect;
+	};
+
+	/* Bitmaps exceeding the maximum texture size ("mega bitmaps")
+	 * are stored as a grid of regular bitmaps. Their own texture
+	 * (getGLTypes()/bindTex()) is not usable, contexts supporting
+	 * mega bitmaps have to render their tiles instead */
+	bool isMega() const;
+	const std::vector<Tile> &getTiles() const;
 	void ensureNonMega() const;
 
 	/* Binds the backing texture and sets the correct
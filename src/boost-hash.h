@@ -58,6 +58,11 @@ public:
 		p.erase(key);
 	}
 
+	inline void clear()
+	{
+		p.clear();
+	}
+
 	inline const V value(const K &key) const
 	{
 		const_iterator iter = p.find(key);
@@ -83,6 +88,11 @@ public:
 		return p[key];
 	}
 
+	inline const_iterator find(const K &key) const
+	{
+		return p.find(key);
+	}
+
 	inline const_iterator cbegin() const
 	{
 		return p.cbegin();
@@ -169,7 +169,12 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(solidFonts, bool, false) \
 	PO_DESC(subImageFix, bool, false) \
 	PO_DESC(enableBlitting, bool, true) \
+	PO_DESC(directBlending, bool, true) \
 	PO_DESC(maxTextureSize, int, 0) \
+	PO_DESC(radialBlurMaxSamples, int, 0) \
+	PO_DESC(rpgCacheSize, int, 128) \
+	PO_DESC(dataCacheSize, int, 16) \
+	PO_DESC(vramGCWatermark, int, 256) \
 	PO_DESC(gameFolder, std::string, ".") \
 	PO_DESC(anyAltToggleFS, bool, false) \
 	PO_DESC(enableReset, bool, true) \
@@ -185,7 +190,11 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(SE.sourceCount, int, 6) \
 	PO_DESC(customScript, std::string, "") \
 	PO_DESC(pathCache, bool, true) \
-	PO_DESC(useScriptNames, bool, false)
+	PO_DESC(extensionOrder, std::string, "") \
+	PO_DESC(useScriptNames, bool, false) \
+	PO_DESC(scriptCache, bool, true) \
+	PO_DESC(profileScripts, bool, false) \
+	PO_DESC(profilerHotkey, bool, false)
 
 // Not gonna take your shit boost
 #define GUARD_ALL( exp ) try { exp } catch(...) {}
@@ -51,13 +51,19 @@ struct Config
 
 	bool subImageFix;
 	bool enableBlitting;
+	bool directBlending;
 	int maxTextureSize;
+	int radialBlurMaxSamples;
+	int rpgCacheSize;
+	int dataCacheSize;
+	int vramGCWatermark;
 
 	std::string gameFolder;
 	bool anyAltToggleFS;
 	bool enableReset;
 	bool allowSymlinks;
 	bool pathCache;
+	std::string extensionOrder;
 
 	std::string dataPathOrg;
 	std::string dataPathApp;
@@ -79,6 +85,9 @@ struct Config
 	} SE;
 
 	bool useScriptNames;
+	bool scriptCache;
+	bool profileScripts;
+	bool profilerHotkey;
 
 	std::string customScript;
 	std::set<std::string> preloadScripts;
@@ -308,6 +308,15 @@ void EventThread::process(RGSSThreadData &rtData)
 				break;
 			}
 
+			if (event.key.keysym.scancode == SDL_SCANCODE_F11
+			    && rtData.config.profilerHotkey)
+			{
+				if (!event.key.repeat)
+					rtData.rqProfilerToggle.set();
+
+				break;
+			}
+
 			if (event.key.keysym.scancode == SDL_SCANCODE_F12)
 			{
 				if (!rtData.config.enableReset)
@@ -229,6 +229,9 @@ struct RGSSThreadData
 	/* Set when F12 is released */
 	AtomicFlag rqResetFinish;
 
+	/* Set when F11 is pressed */
+	AtomicFlag rqProfilerToggle;
+
 	EventThread *ethread;
 	UnidirMessage<Vec2i> windowSizeMsg;
 	UnidirMessage<BDescVec> bindingUpdateMsg;
@@ -32,12 +32,16 @@
 #include <physfs.h>
 
 #include <SDL_sound.h>
+#include <SDL_mutex.h>
+#include <SDL_timer.h>
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <algorithm>
 #include <vector>
-#include <stack>
 
 #ifdef __APPLE__
 #include <iconv.h>
@@ -299,12 +303,32 @@ const Uint32 SDL_RWOPS_PHYSFS = SDL_RWOPS_UNKNOWN+10;
 
 struct FileSystemPrivate
 {
-	/* Maps: lower case full filepath,
-	 * To:   mixed case full filepath */
-	BoostHash<std::string, std::string> pathCache;
-	/* Maps: lower case directory path,
-	 * To:   list of lower case filenames */
-	BoostHash<std::string, std::vector<std::string> > fileLists;
+	/* Maps: directory path plus file name, cut off at each '.'
+	 *       as well as complete (lower case with path cache),
+	 * To:   list of matching mixed case full filepaths */
+	BoostHash<std::string, std::vector<std::string> > fileIndex;
+
+	/* Paths passed to addPath(), in mount order */
+	std::vector<std::string> searchPaths;
+
+	/* Those of them which are directories, so
+	 * files might appear in them at runtime */
+	std::vector<std::string> searchDirs;
+
+	/* Maps: lookups that didn't find anything (without path cache),
+	 * To:   stamp of the searched directories at the time */
+	struct Miss
+	{
+		uint64_t stamp;
+		/* When 'stamp' was last confirmed (SDL ticks) */
+		Uint32 checked;
+	};
+
+	BoostHash<std::string, Miss> missCache;
+	SDL_mutex *missMutex;
+
+	/* Lower case extensions, most preferred first */
+	std::vector<std::string> extOrder;
 
 	/* This is for compatibility with games that take Windows'
 	 * case insensitivity for granted */
@@ -336,6 +360,7 @@ FileSystem::FileSystem(const char *argv0,
 
 	p = new FileSystemPrivate;
 	p->havePathCache = false;
+	p->missMutex = SDL_CreateMutex();
 
 	if (allowSymlinks)
 		PHYSFS_permitSymbolicLinks(1);
@@ -343,6 +368,7 @@ FileSystem::FileSystem(const char *argv0,
 
 FileSystem::~FileSystem()
 {
+	SDL_DestroyMutex(p->missMutex);
 	delete p;
 
 	if (PHYSFS_deinit() == 0)
@@ -351,6 +377,14 @@ FileSystem::~FileSystem()
 
 void FileSystem::addPath(const char *path)
 {
+	p->searchPaths.push_back(path);
+	p->missCache.clear();
+
+	struct stat st;
+
+	if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+		p->searchDirs.push_back(path);
+
 	/* Try the normal mount first */
 	if (!PHYSFS_mount(path, 0, 1))
 	{
@@ -363,10 +397,42 @@ void FileSystem::addPath(const char *path)
 	}
 }
 
+void FileSystem::setExtensionOrder(const char *order)
+{
+	p->extOrder.clear();
+
+	std::string ext;
+
+	for (const char *c = order; ; ++c)
+	{
+		if (*c == ',' || *c == '\0')
+		{
+			if (!ext.empty())
+				p->extOrder.push_back(ext);
+
+			ext.clear();
+
+			if (*c == '\0')
+				break;
+		}
+		else if (*c != ' ' && *c != '.')
+		{
+			ext += tolower(*c);
+		}
+	}
+}
+
 struct CacheEnumData
 {
 	FileSystemPrivate *p;
-	std::stack<std::vector<std::string>*> fileLists;
+
+	/* Directories present in multiple search paths are
+	 * enumerated (merged) the first time already */
+	BoostSet<std::string> visitedDirs;
+
+	/* Everything we found, in enumeration order */
+	std::vector<std::string> dirs;
+	std::vector<std::string> files;
 
 #ifdef __APPLE__
 	iconv_t nfd2nfc;
@@ -412,6 +478,61 @@ struct CacheEnumData
 	}
 };
 
+/* Position of the file's extension in the preference
+ * order, unlisted ones coming last */
+static size_t
+extRank(const FileSystemPrivate *p, const std::string &path)
+{
+	const char *ext = findExt(path.c_str());
+
+	if (!ext)
+		return p->extOrder.size();
+
+	std::string lowExt(ext);
+	strTolower(lowExt);
+
+	std::vector<std::string>::const_iterator iter =
+	        std::find(p->extOrder.begin(), p->extOrder.end(), lowExt);
+
+	return iter - p->extOrder.begin();
+}
+
+static void
+indexFile(FileSystemPrivate *p, const std::string &fullPath)
+{
+	size_t rank = extRank(p, fullPath);
+	std::string key = fullPath;
+
+	if (p->havePathCache)
+		strTolower(key);
+
+	size_t delim = key.rfind('/');
+	size_t nameOffset = (delim == key.npos) ? 0 : delim + 1;
+
+	/* Register the file under every name it can be opened by,
+	 * ie. without any (or only part) of its extensions */
+	for (size_t i = nameOffset + 1; i <= key.size(); ++i)
+	{
+		if (i < key.size() && key[i] != '.')
+			continue;
+
+		std::vector<std::string> &list = p->fileIndex[key.substr(0, i)];
+
+		/* Files present in multiple search paths are enumerated
+		 * once per path, but can only be opened by one */
+		if (std::find(list.begin(), list.end(), fullPath) != list.end())
+			continue;
+
+		/* Keep candidates sorted by extension preference */
+		std::vector<std::string>::iterator iter = list.begin();
+
+		while (iter != list.end() && extRank(p, *iter) <= rank)
+			++iter;
+
+		list.insert(iter, fullPath);
+	}
+}
+
 static PHYSFS_EnumerateCallbackResult
 cacheEnumCB(void *d, const char *origdir, const char *fname)
 {
@@ -426,46 +547,307 @@ cacheEnumCB(void *d, const char *origdir, const char *fname)
 	/* Deal with OSX' weird UTF-8 standards */
 	data.toNFC(fullPath);
 
-	std::string mixedCase(fullPath);
-	std::string lowerCase = mixedCase;
-	strTolower(lowerCase);
-
 	PHYSFS_Stat stat;
 	PHYSFS_stat(fullPath, &stat);
 
 	if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
 	{
-		/* Create a new list for this directory */
-		std::vector<std::string> &list = data.p->fileLists[lowerCase];
+		if (data.visitedDirs.contains(fullPath))
+			return PHYSFS_ENUM_OK;
+
+		data.visitedDirs.insert(fullPath);
+		data.dirs.push_back(fullPath);
 
 		/* Iterate over its contents */
-		data.fileLists.push(&list);
 		PHYSFS_enumerate(fullPath, cacheEnumCB, d);
-		data.fileLists.pop();
+
+		return PHYSFS_ENUM_OK;
 	}
-	else
+
+	data.files.push_back(fullPath);
+	indexFile(data.p, fullPath);
+
+	return PHYSFS_ENUM_OK;
+}
+
+/* The index is persisted across launches, together with the
+ * modification times of all mounted archives and directories.
+ * Adding, removing or renaming a file always touches the
+ * directory (or archive) containing it */
+#define INDEX_FORMAT_VER 2
+
+/* Modification time in nanoseconds, where the platform has them */
+static uint64_t
+statMTime(const struct stat &st)
+{
+#if defined(__APPLE__)
+	return (uint64_t) st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+	return (uint64_t) st.st_mtime * 1000000000;
+#else
+	return (uint64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+struct PathStamp
+{
+	std::string path;
+	uint64_t mtime;
+	uint64_t size;
+};
+
+static bool
+stampPath(const std::string &path, PathStamp &stamp)
+{
+	struct stat st;
+
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+
+	stamp.path = path;
+	stamp.mtime = statMTime(st);
+	stamp.size = S_ISDIR(st.st_mode) ? 0 : st.st_size;
+
+	return true;
+}
+
+static std::string
+currentDir()
+{
+	char buffer[1024];
+
+	if (!getcwd(buffer, sizeof(buffer)))
+		return std::string();
+
+	return buffer;
+}
+
+static std::string
+indexCachePath(const char *dir, const std::string &gameDir)
+{
+	/* FNV-1a, to tell different games apart */
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < gameDir.size(); ++i)
+		hash = (hash ^ (uint8_t) gameDir[i]) * 16777619u;
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%sfileindex-%08x.mkxp", dir, hash);
+
+	return path;
+}
+
+static void
+writeU64(FILE *f, uint64_t value)
+{
+	fwrite(&value, sizeof(value), 1, f);
+}
+
+static void
+writeString(FILE *f, const std::string &str)
+{
+	writeU64(f, str.size());
+	fwrite(str.c_str(), 1, str.size(), f);
+}
+
+static bool
+readU64(FILE *f, uint64_t &value)
+{
+	return fread(&value, sizeof(value), 1, f) == 1;
+}
+
+static bool
+readString(FILE *f, std::string &str)
+{
+	uint64_t len;
+
+	/* Arbitrary max value */
+	if (!readU64(f, len) || len > 4096)
+		return false;
+
+	str.resize(len);
+
+	return len == 0 || fread(&str[0], 1, len, f) == len;
+}
+
+/* Upper bound for any record count still to be read */
+static uint64_t
+remainingBytes(FILE *f)
+{
+	long pos = ftell(f);
+
+	if (pos < 0 || fseek(f, 0, SEEK_END) != 0)
+		return 0;
+
+	long end = ftell(f);
+	fseek(f, pos, SEEK_SET);
+
+	return end > pos ? end - pos : 0;
+}
+
+static void
+writeIndexCache(const std::string &cachePath, const std::string &gameDir,
+                const FileSystemPrivate *p, const CacheEnumData &data)
+{
+	std::vector<PathStamp> stamps;
+	PathStamp stamp;
+
+	for (size_t i = 0; i < p->searchPaths.size(); ++i)
 	{
-		/* Get the file list for the directory we're currently
-		 * traversing and append this filename to it */
-		std::vector<std::string> &list = *data.fileLists.top();
-		std::string lowerFilename(fname);
-		strTolower(lowerFilename);
-		list.push_back(lowerFilename);
-
-		/* Add the lower -> mixed mapping of the file's full path */
-		data.p->pathCache.insert(lowerCase, mixedCase);
+		const std::string &root = p->searchPaths[i];
+
+		if (!stampPath(root, stamp))
+			continue;
+
+		stamps.push_back(stamp);
+
+		/* Archives are covered by their own stamp */
+		if (stamp.size != 0)
+			continue;
+
+		for (size_t j = 0; j < data.dirs.size(); ++j)
+			if (stampPath(root + "/" + data.dirs[j], stamp))
+				stamps.push_back(stamp);
 	}
 
-	return PHYSFS_ENUM_OK;
+	/* Written next to the final file and renamed over it, so
+	 * an interrupted write can't leave a truncated cache behind */
+	const std::string tmpPath = cachePath + ".tmp";
+	FILE *f = fopen(tmpPath.c_str(), "wb");
+
+	if (!f)
+		return;
+
+	writeU64(f, INDEX_FORMAT_VER);
+	writeString(f, gameDir);
+	writeU64(f, p->havePathCache);
+
+	writeU64(f, p->searchPaths.size());
+	for (size_t i = 0; i < p->searchPaths.size(); ++i)
+		writeString(f, p->searchPaths[i]);
+
+	writeU64(f, stamps.size());
+	for (size_t i = 0; i < stamps.size(); ++i)
+	{
+		writeString(f, stamps[i].path);
+		writeU64(f, stamps[i].mtime);
+		writeU64(f, stamps[i].size);
+	}
+
+	writeU64(f, data.files.size());
+	for (size_t i = 0; i < data.files.size(); ++i)
+		writeString(f, data.files[i]);
+
+	bool ok = !ferror(f);
+	ok = (fclose(f) == 0) && ok;
+
+	if (ok)
+	{
+#ifdef _WIN32
+		/* rename() doesn't replace existing files here */
+		remove(cachePath.c_str());
+#endif
+		ok = rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+	}
+
+	if (!ok)
+		remove(tmpPath.c_str());
 }
 
-void FileSystem::createPathCache()
+static bool
+readIndexCache(FILE *f, const std::string &gameDir,
+               const FileSystemPrivate *p, std::vector<std::string> &files)
 {
+	uint64_t value;
+	std::string str;
+
+	if (!readU64(f, value) || value != INDEX_FORMAT_VER)
+		return false;
+
+	if (!readString(f, str) || str != gameDir)
+		return false;
+
+	if (!readU64(f, value) || value != (uint64_t) p->havePathCache)
+		return false;
+
+	if (!readU64(f, value) || value != p->searchPaths.size())
+		return false;
+
+	for (size_t i = 0; i < p->searchPaths.size(); ++i)
+		if (!readString(f, str) || str != p->searchPaths[i])
+			return false;
+
+	/* Smallest possible records: an empty string (just its
+	 * length), plus the two stamp values for path stamps */
+	uint64_t count;
+
+	if (!readU64(f, count) || count > remainingBytes(f) / 24)
+		return false;
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		PathStamp stored, current;
+
+		if (!readString(f, stored.path) ||
+		    !readU64(f, stored.mtime) || !readU64(f, stored.size))
+			return false;
+
+		if (!stampPath(stored.path, current))
+			return false;
+
+		if (current.mtime != stored.mtime || current.size != stored.size)
+			return false;
+	}
+
+	if (!readU64(f, count) || count > remainingBytes(f) / 8)
+		return false;
+
+	files.resize(count);
+
+	for (uint64_t i = 0; i < count; ++i)
+		if (!readString(f, files[i]))
+			return false;
+
+	return true;
+}
+
+void FileSystem::createIndex(bool pathCache, const char *cacheDir)
+{
+	p->havePathCache = pathCache;
+	p->missCache.clear();
+
+	std::string gameDir = currentDir();
+	std::string cachePath;
+
+	if (cacheDir && *cacheDir && !gameDir.empty())
+		cachePath = indexCachePath(cacheDir, gameDir);
+
+	if (!cachePath.empty())
+	{
+		std::vector<std::string> files;
+		FILE *f = fopen(cachePath.c_str(), "rb");
+		bool valid = false;
+
+		if (f)
+		{
+			valid = readIndexCache(f, gameDir, p, files);
+			fclose(f);
+		}
+
+		if (valid)
+		{
+			for (size_t i = 0; i < files.size(); ++i)
+				indexFile(p, files[i]);
+
+			return;
+		}
+	}
+
 	CacheEnumData data(p);
-	data.fileLists.push(&p->fileLists[""]);
 	PHYSFS_enumerate("", cacheEnumCB, &data);
 
-	p->havePathCache = true;
+	if (!cachePath.empty())
+		writeIndexCache(cachePath, gameDir, p, data);
 }
 
 struct FontSetsCBData
@@ -540,6 +922,41 @@ void FileSystem::initFontSets(SharedFontState &sfs)
 	PHYSFS_enumerate("", findFontsFolderCB, &d);
 }
 
+/* Known misses are trusted without looking at the
+ * directories again for this long */
+#define MISS_RECHECK_MS 20
+
+/* Changes whenever 'dir' is created, removed or modified in any of
+ * the directory search paths. Filesystems with coarse timestamps
+ * might not register a change within the same second though, so
+ * 'fresh' is set if any of them were modified that recently */
+static uint64_t
+dirStamp(const FileSystemPrivate *p, const char *dir, bool &fresh)
+{
+	uint64_t stamp = 0;
+	time_t now = time(0);
+
+	fresh = false;
+
+	for (size_t i = 0; i < p->searchDirs.size(); ++i)
+	{
+		std::string path = p->searchDirs[i] + "/" + dir;
+		struct stat st;
+
+		stamp *= 31;
+
+		if (stat(path.c_str(), &st) != 0)
+			continue;
+
+		stamp += statMTime(st) + 1;
+
+		if (st.st_mtime >= now - 1)
+			fresh = true;
+	}
+
+	return stamp;
+}
+
 struct OpenReadEnumData
 {
 	FileSystem::OpenHandler &handler;
@@ -549,27 +966,59 @@ struct OpenReadEnumData
 	const char *filename;
 	size_t filenameN;
 
-	/* Optional hash to translate full filepaths
-	 * (used with path cache) */
-	BoostHash<std::string, std::string> *pathTrans;
-
 	/* Number of files we've attempted to read and parse */
 	size_t matchCount;
 	bool stopSearching;
 
+	/* The file the handler accepted */
+	std::string foundPath;
+
 	/* In case of a PhysFS error, save it here so it
 	 * doesn't get changed before we get back into our code */
 	const char *physfsError;
 
 	OpenReadEnumData(FileSystem::OpenHandler &handler,
-	                 const char *filename, size_t filenameN,
-	                 BoostHash<std::string, std::string> *pathTrans)
+	                 const char *filename, size_t filenameN)
 	    : handler(handler), filename(filename), filenameN(filenameN),
-	      pathTrans(pathTrans), matchCount(0), stopSearching(false),
-	      physfsError(0)
+	      matchCount(0), stopSearching(false), physfsError(0)
 	{}
 };
 
+/* Hands the file at 'fullPath' to the handler */
+static void
+openReadMatch(OpenReadEnumData &data, const char *fullPath)
+{
+	PHYSFS_File *phys = PHYSFS_openRead(fullPath);
+
+	if (!phys)
+	{
+		/* Index entries can go stale when files are deleted
+		 * after startup; those simply don't count as a match */
+		if (!PHYSFS_exists(fullPath))
+			return;
+
+		/* Failing to open this file here means there must
+		 * be a deeper rooted problem somewhere within PhysFS.
+		 * Just abort alltogether. */
+		data.stopSearching = true;
+		data.physfsError = PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
+
+		return;
+	}
+
+	initReadOps(phys, data.ops, false);
+
+	const char *ext = findExt(fullPath);
+
+	if (data.handler.tryRead(data.ops, ext))
+	{
+		data.stopSearching = true;
+		data.foundPath = fullPath;
+	}
+
+	++data.matchCount;
+}
+
 static PHYSFS_EnumerateCallbackResult
 openReadEnumCB(void *d, const char *dirpath, const char *filename)
 {
@@ -600,38 +1049,15 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename)
 	 * of the extension), or up to a following '\0' (full match), we've
 	 * found our file */
 	if (last != '.' && last != '\0')
-		return PHYSFS_ENUM_STOP;
-
-	/* If the path cache is active, translate from lower case
-	 * to mixed case path */
-	if (data.pathTrans)
-		fullPath = (*data.pathTrans)[fullPath].c_str();
-
-	PHYSFS_File *phys = PHYSFS_openRead(fullPath);
-
-	if (!phys)
-	{
-		/* Failing to open this file here means there must
-		 * be a deeper rooted problem somewhere within PhysFS.
-		 * Just abort alltogether. */
-		data.stopSearching = true;
-		data.physfsError = PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
-
-		return PHYSFS_ENUM_ERROR;
-	}
-
-	initReadOps(phys, data.ops, false);
-
-	const char *ext = findExt(filename);
+		return PHYSFS_ENUM_OK;
 
-	if (data.handler.tryRead(data.ops, ext))
-		data.stopSearching = true;
+	openReadMatch(data, fullPath);
 
-	++data.matchCount;
-	return PHYSFS_ENUM_OK;
+	return data.physfsError ? PHYSFS_ENUM_ERROR : PHYSFS_ENUM_OK;
 }
 
-void FileSystem::openRead(OpenHandler &handler, const char *filename)
+void FileSystem::openRead(OpenHandler &handler, const char *filename,
+                          std::string *foundPath)
 {
 	char buffer[512];
 	size_t len = strcpySafe(buffer, filename, sizeof(buffer), -1);
@@ -647,34 +1073,84 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename)
 			break;
 
 	const bool root = (delim == buffer);
+	const char *file = root ? buffer : delim+1;
+
+	OpenReadEnumData data(handler, file, len + buffer - file);
 
-	const char *file = buffer;
-	const char *dir = "";
+	/* All candidates are known up front; only lookups that don't
+	 * use the path cache fall back to searching the directory, to
+	 * pick up files created after mounting (or replacing indexed
+	 * candidates that have since been deleted) */
+	BoostHash<std::string, std::vector<std::string> >::const_iterator iter =
+	        p->fileIndex.find(buffer);
+
+	if (iter != p->fileIndex.cend())
+	{
+		const std::vector<std::string> &matches = iter->second;
+
+		for (size_t i = 0; i < matches.size() && !data.stopSearching; ++i)
+			openReadMatch(data, matches[i].c_str());
+	}
 
-	if (!root)
+	if (!p->havePathCache && data.matchCount == 0 && !data.physfsError)
 	{
+		std::string key(buffer);
+
 		/* Cut the buffer in half so we can use it
 		 * for both filename and directory path */
-		*delim = '\0';
-		file = delim+1;
-		dir = buffer;
-	}
+		if (!root)
+			*delim = '\0';
 
-	OpenReadEnumData data(handler, file, len + buffer - delim - !root,
-	                      p->havePathCache ? &p->pathCache : 0);
+		const char *dir = root ? "" : buffer;
 
-	if (p->havePathCache)
-	{
-		/* Get the list of files contained in this directory
-		 * and manually iterate over them */
-		const std::vector<std::string> &fileList = p->fileLists[dir];
+		/* Scripts probing for optional assets tend to ask for the
+		 * same missing files over and over. As long as none of the
+		 * directories they'd appear in changed, the answer stays */
+		const Uint32 now = SDL_GetTicks();
+		bool knownMiss = false;
+		bool checked = false;
 
-		for (size_t i = 0; i < fileList.size(); ++i)
-			openReadEnumCB(&data, dir, fileList[i].c_str());
-	}
-	else
-	{
-		PHYSFS_enumerate(dir, openReadEnumCB, &data);
+		SDL_LockMutex(p->missMutex);
+
+		if (p->missCache.contains(key))
+		{
+			FileSystemPrivate::Miss &miss = p->missCache[key];
+			knownMiss = checked = (now - miss.checked < MISS_RECHECK_MS);
+		}
+
+		SDL_UnlockMutex(p->missMutex);
+
+		bool fresh = false;
+		uint64_t stamp = 0;
+
+		if (!checked)
+		{
+			stamp = dirStamp(p, dir, fresh);
+
+			SDL_LockMutex(p->missMutex);
+
+			if (p->missCache.contains(key) && p->missCache[key].stamp == stamp)
+			{
+				p->missCache[key].checked = now;
+				knownMiss = true;
+			}
+
+			SDL_UnlockMutex(p->missMutex);
+		}
+
+		if (!knownMiss)
+		{
+			PHYSFS_enumerate(dir, openReadEnumCB, &data);
+
+			if (data.matchCount == 0 && !data.physfsError && !fresh)
+			{
+				FileSystemPrivate::Miss miss = { stamp, now };
+
+				SDL_LockMutex(p->missMutex);
+				p->missCache[key] = miss;
+				SDL_UnlockMutex(p->missMutex);
+			}
+		}
 	}
 
 	if (data.physfsError)
@@ -682,6 +1158,29 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename)
 
 	if (data.matchCount == 0)
 		throw Exception(Exception::NoFileError, "%s", filename);
+
+	if (foundPath)
+		*foundPath = data.foundPath;
+}
+
+/* Accepts the first file without reading it */
+struct ResolveHandler : FileSystem::OpenHandler
+{
+	bool tryRead(SDL_RWops &ops, const char *)
+	{
+		SDL_RWclose(&ops);
+		return true;
+	}
+};
+
+std::string FileSystem::resolvePath(const char *filename)
+{
+	ResolveHandler handler;
+	std::string path;
+
+	openRead(handler, filename, &path);
+
+	return path;
 }
 
 void FileSystem::openReadRaw(SDL_RWops &ops,
@@ -698,3 +1197,36 @@ bool FileSystem::exists(const char *filename)
 {
 	return PHYSFS_exists(filename);
 }
+
+uint64_t FileSystem::fileStamp(const char *filename)
+{
+	PHYSFS_Stat stat;
+
+	if (!PHYSFS_stat(filename, &stat))
+		return 0;
+
+	uint64_t stamp = stat.modtime * 31 + stat.filesize;
+
+	/* Archive entries don't carry modification times, so
+	 * take the archive's own (directories have size 0).
+	 * Files in directories are stat'ed directly instead,
+	 * as PhysFS only reports whole seconds */
+	const char *realDir = PHYSFS_getRealDir(filename);
+	PathStamp dirStamp, realStamp;
+
+	if (realDir && stampPath(realDir, dirStamp))
+	{
+		if (dirStamp.size != 0)
+		{
+			stamp = stamp * 31 + dirStamp.mtime;
+			stamp = stamp * 31 + dirStamp.size;
+		}
+		else if (stampPath(std::string(realDir) + "/" + filename, realStamp))
+		{
+			stamp = stamp * 31 + realStamp.mtime;
+		}
+	}
+
+	/* Never collide with "doesn't exist" */
+	return stamp ? stamp : 1;
+}
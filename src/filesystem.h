@@ -24,6 +24,8 @@
 
 #include <SDL_rwops.h>
 
+#include <string>
+
 struct FileSystemPrivate;
 class SharedFontState;
 
@@ -36,8 +38,18 @@ public:
 
 	void addPath(const char *path);
 
+	/* Comma separated list of extensions; when a file is requested
+	 * without one, candidates are tried in this order. Call before
+	 * 'createIndex()' */
+	void setExtensionOrder(const char *order);
+
 	/* Call these after the last 'addPath()' */
-	void createPathCache();
+
+	/* Indexes all mounted files for openRead(). With 'pathCache',
+	 * lookups become case insensitive. If 'cacheDir' is given, the
+	 * index is stored there and reused by later launches for as
+	 * long as none of the mounted paths changed */
+	void createIndex(bool pathCache, const char *cacheDir = 0);
 
 	/* Scans "Fonts/" and creates inventory of
 	 * available font assets */
@@ -56,8 +68,15 @@ public:
 		virtual bool tryRead(SDL_RWops &ops, const char *ext) = 0;
 	};
 
+	/* If given, 'foundPath' receives the path of
+	 * the file the handler accepted */
 	void openRead(OpenHandler &handler,
-	              const char *filename);
+	              const char *filename,
+	              std::string *foundPath = 0);
+
+	/* Path of the first file openRead() would offer the
+	 * handler for 'filename'; throws NoFileError like it */
+	std::string resolvePath(const char *filename);
 
 	/* Circumvents extension supplementing */
 	void openReadRaw(SDL_RWops &ops,
@@ -67,6 +86,10 @@ public:
 	/* Does not perform extension supplementing */
 	bool exists(const char *filename);
 
+	/* Changes whenever 'filename' is modified, or the archive
+	 * providing it replaced. 0 if the file doesn't exist */
+	uint64_t fileStamp(const char *filename);
+
 private:
 	FileSystemPrivate *p;
 };
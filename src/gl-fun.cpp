@@ -190,4 +190,7 @@ void initGLFunctions()
 
 	if (!gles || glMajor >= 3 || HAVE_EXT(OES_texture_npot))
 		gl.npot_repeat = true;
+
+	if (HAVE_EXT(EXT_shader_framebuffer_fetch))
+		gl.fb_fetch = true;
 }
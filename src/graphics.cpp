@@ -706,6 +706,14 @@ void Graphics::transition(int duration,
 	vague = clamp(vague, 1, 256);
 	Bitmap *transMap = *filename ? new Bitmap(filename) : 0;
 
+	/* The transition shader samples it as a single texture */
+	if (transMap && transMap->isMega())
+	{
+		delete transMap;
+		throw Exception(Exception::MKXPError,
+		                "Transition bitmap is too large");
+	}
+
 	setBrightness(255);
 
 	/* Capture new scene */
@@ -0,0 +1,191 @@
+/*
+** imagecache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imagecache.h"
+
+#include "sharedstate.h"
+#include "texpool.h"
+#include "boost-hash.h"
+
+#include <assert.h>
+
+static uint32_t byteCount(const SharedImage &image)
+{
+	return image.gl.width * image.gl.height * 4;
+}
+
+struct ImageCachePrivate
+{
+	BoostHash<std::string, SharedImage*> images;
+
+	/* Unreferenced images, most recently released first */
+	std::list<SharedImage*> unused;
+
+	/* Maximal allowed memory for unreferenced images */
+	const uint32_t maxMemSize;
+
+	/* Memory currently taken up by unreferenced images */
+	uint32_t memSize;
+
+	ImageCachePrivate(uint32_t maxMemSize)
+	    : maxMemSize(maxMemSize),
+	      memSize(0)
+	{}
+
+	void destroy(SharedImage *image)
+	{
+		if (!image->stale)
+			images.remove(image->key);
+
+		shState->texPool().release(image->gl);
+
+		delete image;
+	}
+
+	/* Takes 'image' out of the lookup, freeing it
+	 * right away if nobody references it */
+	void drop(SharedImage *image)
+	{
+		if (image->refCount > 0)
+		{
+			images.remove(image->key);
+			image->stale = true;
+
+			return;
+		}
+
+		unused.erase(image->lruIter);
+		memSize -= byteCount(*image);
+		destroy(image);
+	}
+
+	void trim()
+	{
+		while (memSize > maxMemSize && !unused.empty())
+		{
+			SharedImage *image = unused.back();
+			unused.pop_back();
+
+			memSize -= byteCount(*image);
+			destroy(image);
+		}
+	}
+};
+
+ImageCache::ImageCache(uint32_t maxMemSize)
+{
+	p = new ImageCachePrivate(maxMemSize);
+}
+
+ImageCache::~ImageCache()
+{
+	/* Images still referenced at this point are leaked,
+	 * they're cleaned up along with the GL context */
+	while (!p->unused.empty())
+	{
+		p->destroy(p->unused.back());
+		p->unused.pop_back();
+	}
+
+	delete p;
+}
+
+SharedImage *ImageCache::acquire(const std::string &key, uint64_t stamp)
+{
+	SharedImage *image = p->images.value(key, 0);
+
+	if (!image)
+		return 0;
+
+	/* The file changed since */
+	if (image->stamp != stamp)
+	{
+		p->drop(image);
+		return 0;
+	}
+
+	addRef(image);
+
+	return image;
+}
+
+bool ImageCache::contains(const std::string &key, uint64_t stamp) const
+{
+	SharedImage *image = p->images.value(key, 0);
+
+	return image && image->stamp == stamp;
+}
+
+SharedImage *ImageCache::insert(const std::string &key, uint64_t stamp,
+                                const TEXFBO &tex, bool opaque)
+{
+	SharedImage *previous = p->images.value(key, 0);
+
+	if (previous)
+		p->drop(previous);
+
+	SharedImage *image = new SharedImage;
+	image->gl = tex;
+	image->opaque = opaque;
+	image->key = key;
+	image->stamp = stamp;
+	image->stale = false;
+	image->refCount = 1;
+
+	p->images.insert(key, image);
+
+	return image;
+}
+
+void ImageCache::addRef(SharedImage *image)
+{
+	if (image->refCount++ > 0)
+		return;
+
+	/* Revived from the unused list */
+	p->unused.erase(image->lruIter);
+	p->memSize -= byteCount(*image);
+}
+
+void ImageCache::release(SharedImage *image)
+{
+	assert(image->refCount > 0);
+
+	if (--image->refCount > 0)
+		return;
+
+	if (image->stale)
+	{
+		p->destroy(image);
+		return;
+	}
+
+	p->unused.push_front(image);
+	image->lruIter = p->unused.begin();
+	p->memSize += byteCount(*image);
+
+	p->trim();
+}
+
+uint64_t ImageCache::retainedMemSize() const
+{
+	return p->memSize;
+}
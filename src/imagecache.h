@@ -0,0 +1,86 @@
+/*
+** imagecache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include "gl-util.h"
+
+#include <string>
+#include <list>
+#include <stdint.h>
+
+/* A texture holding the unmodified contents of an image file,
+ * shared by all Bitmaps created from that file */
+struct SharedImage
+{
+	TEXFBO gl;
+
+	/* Image has no transparent pixels */
+	bool opaque;
+
+	/* <internal> */
+	std::string key;
+	/* FileSystem::fileStamp() of the file it was loaded from */
+	uint64_t stamp;
+	/* Superseded by a newer version of the file; only
+	 * lives on for as long as it is referenced */
+	bool stale;
+	int refCount;
+	std::list<SharedImage*>::iterator lruIter;
+};
+
+struct ImageCachePrivate;
+
+/* Keeps track of shared image textures, keyed by the path of the
+ * file they were loaded from. Images nobody references anymore are
+ * retained for reuse until they exceed the memory budget, at which
+ * point the least recently used ones are handed back to the TexPool */
+class ImageCache
+{
+public:
+	ImageCache(uint32_t maxMemSize = 32000000 /* 32 MB */);
+	~ImageCache();
+
+	/* Returns the image stored under 'key' with an added
+	 * reference, or null if there is none. An image loaded
+	 * from a file with a different 'stamp' is dropped */
+	SharedImage *acquire(const std::string &key, uint64_t stamp);
+
+	bool contains(const std::string &key, uint64_t stamp) const;
+
+	/* Takes ownership of 'tex' and stores it under 'key',
+	 * replacing any previous image. The returned image
+	 * starts out with one reference */
+	SharedImage *insert(const std::string &key, uint64_t stamp,
+	                    const TEXFBO &tex, bool opaque);
+
+	void addRef(SharedImage *image);
+	void release(SharedImage *image);
+
+	/* Bytes held by images nobody references */
+	uint64_t retainedMemSize() const;
+
+private:
+	ImageCachePrivate *p;
+};
+
+#endif // IMAGECACHE_H
@@ -0,0 +1,394 @@
+/*
+** imagedecoder.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imagedecoder.h"
+
+#include "filesystem.h"
+#include "exception.h"
+#include "boost-hash.h"
+#include "sdl-util.h"
+
+#include <SDL_image.h>
+#include <SDL_cpuinfo.h>
+#include <SDL_mutex.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+/* Upper bound for the number of worker threads */
+#define MAX_WORKERS 4
+
+/* Decoded surfaces nobody has claimed yet are discarded,
+ * oldest first, once they take up more memory than this */
+#define DECODED_BUDGET (64 * 1024 * 1024)
+
+struct DecodeHandler : FileSystem::OpenHandler
+{
+	SDL_Surface *surf;
+
+	DecodeHandler()
+	    : surf(0)
+	{}
+
+	bool tryRead(SDL_RWops &ops, const char *ext)
+	{
+		surf = IMG_LoadTyped_RW(&ops, 1, ext);
+		return surf != 0;
+	}
+};
+
+struct ImageDecoderPrivate
+{
+	enum State
+	{
+		Queued,
+		Decoding,
+		Done
+	};
+
+	struct Entry
+	{
+		State state;
+		SDL_Surface *surf;
+
+		/* The RGSS thread is waiting for this one */
+		bool wanted;
+
+		Entry()
+		    : state(Queued),
+		      surf(0),
+		      wanted(false)
+		{}
+	};
+
+	FileSystem &fs;
+
+	std::vector<SDL_Thread*> workers;
+
+	/* Protects everything below */
+	SDL_mutex *mutex;
+	/* Signaled when work is queued / on shutdown */
+	SDL_cond *workCond;
+	/* Signaled when an entry is done decoding */
+	SDL_cond *doneCond;
+
+	BoostHash<std::string, Entry> entries;
+	std::deque<std::string> queue;
+
+	/* Done entries in order of completion */
+	std::deque<std::string> done;
+	size_t doneBytes;
+
+	bool quit;
+
+	ImageDecoderPrivate(FileSystem &fs)
+	    : fs(fs),
+	      doneBytes(0),
+	      quit(false)
+	{
+		mutex = SDL_CreateMutex();
+		workCond = SDL_CreateCond();
+		doneCond = SDL_CreateCond();
+	}
+
+	~ImageDecoderPrivate()
+	{
+		SDL_DestroyCond(doneCond);
+		SDL_DestroyCond(workCond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	static size_t surfaceBytes(SDL_Surface *surf)
+	{
+		return surf ? surf->pitch * surf->h : 0;
+	}
+
+	SDL_Surface *decode(const std::string &filename)
+	{
+		DecodeHandler handler;
+
+		try
+		{
+			fs.openRead(handler, filename.c_str());
+		}
+		catch (const Exception &)
+		{
+			/* The RGSS thread will raise the error when
+			 * it tries loading the file by itself */
+			return 0;
+		}
+
+		SDL_Surface *surf = handler.surf;
+
+		if (surf && surf->format->format != SDL_PIXELFORMAT_ABGR8888)
+		{
+			SDL_Surface *conv =
+				SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_ABGR8888, 0);
+			SDL_FreeSurface(surf);
+			surf = conv;
+		}
+
+		return surf;
+	}
+
+	/* Called with mutex held */
+	void removeDone(const std::string &filename)
+	{
+		std::deque<std::string>::iterator iter =
+			std::find(done.begin(), done.end(), filename);
+
+		if (iter != done.end())
+			done.erase(iter);
+	}
+
+	/* Called with mutex held */
+	void enforceBudget()
+	{
+		std::deque<std::string>::iterator iter = done.begin();
+
+		while (doneBytes > DECODED_BUDGET && iter != done.end())
+		{
+			Entry &entry = entries[*iter];
+
+			if (entry.wanted)
+			{
+				++iter;
+				continue;
+			}
+
+			doneBytes -= surfaceBytes(entry.surf);
+
+			if (entry.surf)
+				SDL_FreeSurface(entry.surf);
+
+			entries.remove(*iter);
+			iter = done.erase(iter);
+		}
+	}
+
+	void workerFun()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (queue.empty() && !quit)
+				SDL_CondWait(workCond, mutex);
+
+			if (quit)
+				break;
+
+			const std::string filename = queue.front();
+			queue.pop_front();
+
+			entries[filename].state = Decoding;
+
+			SDL_UnlockMutex(mutex);
+
+			SDL_Surface *surf = decode(filename);
+
+			SDL_LockMutex(mutex);
+
+			Entry &entry = entries[filename];
+			entry.state = Done;
+			entry.surf = surf;
+
+			done.push_back(filename);
+			doneBytes += surfaceBytes(surf);
+
+			enforceBudget();
+
+			SDL_CondBroadcast(doneCond);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+ImageDecoder::ImageDecoder(FileSystem &fs)
+{
+	p = new ImageDecoderPrivate(fs);
+
+	/* Leave one core to the RGSS thread */
+	int count = std::min(std::max(SDL_GetCPUCount() - 1, 1), MAX_WORKERS);
+
+	for (int i = 0; i < count; ++i)
+	{
+		SDL_Thread *thread =
+			createSDLThread<ImageDecoderPrivate, &ImageDecoderPrivate::workerFun>
+				(p, "imgdecoder");
+
+		if (thread)
+			p->workers.push_back(thread);
+	}
+}
+
+ImageDecoder::~ImageDecoder()
+{
+	SDL_LockMutex(p->mutex);
+	p->quit = true;
+	SDL_CondBroadcast(p->workCond);
+	SDL_UnlockMutex(p->mutex);
+
+	for (size_t i = 0; i < p->workers.size(); ++i)
+		SDL_WaitThread(p->workers[i], 0);
+
+	BoostHash<std::string, ImageDecoderPrivate::Entry>::const_iterator iter;
+
+	for (iter = p->entries.cbegin(); iter != p->entries.cend(); ++iter)
+		if (iter->second.surf)
+			SDL_FreeSurface(iter->second.surf);
+
+	delete p;
+}
+
+void ImageDecoder::preload(const char *filename)
+{
+	/* Without workers, preloading is pointless */
+	if (p->workers.empty())
+		return;
+
+	const std::string key(filename);
+
+	SDL_LockMutex(p->mutex);
+
+	if (!p->entries.contains(key))
+	{
+		p->entries.insert(key, ImageDecoderPrivate::Entry());
+		p->queue.push_back(key);
+
+		SDL_CondSignal(p->workCond);
+	}
+
+	SDL_UnlockMutex(p->mutex);
+}
+
+bool ImageDecoder::decode(const char *filename)
+{
+	const std::string key(filename);
+
+	SDL_LockMutex(p->mutex);
+
+	if (p->entries.contains(key))
+	{
+		ImageDecoderPrivate::Entry *entry = &p->entries[key];
+
+		if (entry->state != ImageDecoderPrivate::Queued)
+		{
+			/* Already taken care of by someone else */
+			while (entry->state != ImageDecoderPrivate::Done)
+			{
+				SDL_CondWait(p->doneCond, p->mutex);
+
+				if (!p->entries.contains(key))
+					break;
+
+				entry = &p->entries[key];
+			}
+
+			bool success = p->entries.contains(key) && p->entries[key].surf;
+
+			SDL_UnlockMutex(p->mutex);
+
+			return success;
+		}
+
+		std::deque<std::string>::iterator iter =
+			std::find(p->queue.begin(), p->queue.end(), key);
+
+		if (iter != p->queue.end())
+			p->queue.erase(iter);
+	}
+	else
+	{
+		p->entries.insert(key, ImageDecoderPrivate::Entry());
+	}
+
+	p->entries[key].state = ImageDecoderPrivate::Decoding;
+
+	SDL_UnlockMutex(p->mutex);
+
+	SDL_Surface *surf = p->decode(key);
+
+	SDL_LockMutex(p->mutex);
+
+	ImageDecoderPrivate::Entry &entry = p->entries[key];
+	entry.state = ImageDecoderPrivate::Done;
+	entry.surf = surf;
+
+	/* Make room before adding it, so it survives until taken */
+	p->doneBytes += ImageDecoderPrivate::surfaceBytes(surf);
+	p->enforceBudget();
+
+	p->done.push_back(key);
+
+	SDL_CondBroadcast(p->doneCond);
+	SDL_UnlockMutex(p->mutex);
+
+	return surf != 0;
+}
+
+SDL_Surface *ImageDecoder::take(const char *filename)
+{
+	const std::string key(filename);
+	SDL_Surface *surf = 0;
+
+	SDL_LockMutex(p->mutex);
+
+	if (p->entries.contains(key))
+	{
+		ImageDecoderPrivate::Entry *entry = &p->entries[key];
+
+		if (entry->state == ImageDecoderPrivate::Queued)
+		{
+			/* Not started yet; loading it directly
+			 * is faster than waiting in line */
+			std::deque<std::string>::iterator iter =
+				std::find(p->queue.begin(), p->queue.end(), key);
+
+			if (iter != p->queue.end())
+				p->queue.erase(iter);
+		}
+		else
+		{
+			entry->wanted = true;
+
+			while (entry->state != ImageDecoderPrivate::Done)
+			{
+				SDL_CondWait(p->doneCond, p->mutex);
+				entry = &p->entries[key];
+			}
+
+			surf = entry->surf;
+
+			p->doneBytes -= ImageDecoderPrivate::surfaceBytes(surf);
+			p->removeDone(key);
+		}
+
+		p->entries.remove(key);
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return surf;
+}
@@ -0,0 +1,59 @@
+/*
+** imagedecoder.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEDECODER_H
+#define IMAGEDECODER_H
+
+class FileSystem;
+struct SDL_Surface;
+struct ImageDecoderPrivate;
+
+/* Decodes image files into ABGR8888 surfaces on a pool of
+ * worker threads, ahead of Bitmaps being created from them.
+ * Only the decoding happens asynchronously; texture uploads
+ * are still done by Bitmap on the RGSS thread */
+class ImageDecoder
+{
+public:
+	ImageDecoder(FileSystem &fs);
+	~ImageDecoder();
+
+	/* Queues 'filename' for decoding (unless it already is) */
+	void preload(const char *filename);
+
+	/* Decodes 'filename' on the calling thread, which may be
+	 * any thread, and keeps the result for take(). Returns
+	 * whether the file could be decoded */
+	bool decode(const char *filename);
+
+	/* Returns the decoded surface for 'filename', waiting for
+	 * its decoding to finish if it's currently in progress.
+	 * Ownership of the surface passes to the caller.
+	 * Returns null if the file wasn't queued, hasn't been
+	 * picked up by a worker yet, or failed to decode; in that
+	 * case the caller is expected to load it by itself */
+	SDL_Surface *take(const char *filename);
+
+private:
+	ImageDecoderPrivate *p;
+};
+
+#endif // IMAGEDECODER_H
@@ -0,0 +1,473 @@
+/*
+** pathfinder.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pathfinder.h"
+
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <stdlib.h>
+
+/* Step costs are scaled so diagonals can approximate sqrt(2) */
+#define STRAIGHT_COST 10
+#define DIAGONAL_COST 14
+
+/* Results nobody polled are dropped, oldest first,
+ * once there are more than this */
+#define MAX_UNPOLLED_RESULTS 256
+
+struct Step
+{
+	int dx, dy;
+	/* Blocked bit for leaving the cell in this direction */
+	uint8_t bit;
+};
+
+static const Step straightSteps[] =
+{
+	{  0,  1, Pathfinder::BlockedDown  },
+	{ -1,  0, Pathfinder::BlockedLeft  },
+	{  1,  0, Pathfinder::BlockedRight },
+	{  0, -1, Pathfinder::BlockedUp    }
+};
+
+static uint8_t reverseBit(uint8_t bit)
+{
+	switch (bit)
+	{
+	case Pathfinder::BlockedDown :
+		return Pathfinder::BlockedUp;
+	case Pathfinder::BlockedLeft :
+		return Pathfinder::BlockedRight;
+	case Pathfinder::BlockedRight :
+		return Pathfinder::BlockedLeft;
+	default:
+		return Pathfinder::BlockedDown;
+	}
+}
+
+namespace
+{
+
+struct Search
+{
+	const Pathfinder::Grid &grid;
+
+	Search(const Pathfinder::Grid &grid)
+	    : grid(grid)
+	{}
+
+	bool inside(int x, int y) const
+	{
+		return x >= 0 && y >= 0 && x < grid.width && y < grid.height;
+	}
+
+	int index(int x, int y) const
+	{
+		return y * grid.width + x;
+	}
+
+	uint8_t blocked(int x, int y) const
+	{
+		return grid.blocked.empty() ? 0 : grid.blocked[index(x, y)];
+	}
+
+	/* Whether a single straight step from (x, y) is possible */
+	bool canStep(int x, int y, const Step &step) const
+	{
+		int nx = x + step.dx;
+		int ny = y + step.dy;
+
+		if (!inside(nx, ny) || grid.costs[index(nx, ny)] <= 0)
+			return false;
+
+		if (blocked(x, y) & step.bit)
+			return false;
+
+		return !(blocked(nx, ny) & reverseBit(step.bit));
+	}
+
+	/* Diagonal steps need one of the two orthogonal
+	 * detours to be walkable, just like in RMXP */
+	bool canStepDiagonal(int x, int y, const Step &h, const Step &v) const
+	{
+		int nx = x + h.dx;
+		int ny = y + v.dy;
+
+		if (!inside(nx, ny) || grid.costs[index(nx, ny)] <= 0)
+			return false;
+
+		if (canStep(x, y, h) && canStep(x + h.dx, y, v))
+			return true;
+
+		return canStep(x, y, v) && canStep(x, y + v.dy, h);
+	}
+};
+
+}
+
+bool Pathfinder::find(const Query &query, Path &path)
+{
+	const Grid &grid = query.grid;
+	Search search(grid);
+
+	path.clear();
+
+	const Vec2i &start = query.start;
+	const Vec2i &target = query.target;
+
+	if (!search.inside(start.x, start.y) || !search.inside(target.x, target.y))
+		return false;
+
+	if (grid.costs[search.index(target.x, target.y)] <= 0)
+		return false;
+
+	if (start == target)
+		return true;
+
+	/* The heuristic has to stay below the actual cost */
+	int minCost = INT32_MAX;
+
+	for (size_t i = 0; i < grid.costs.size(); ++i)
+		if (grid.costs[i] > 0)
+			minCost = std::min(minCost, grid.costs[i]);
+
+	const size_t cellCount = (size_t) grid.width * grid.height;
+
+	std::vector<int64_t> cost(cellCount, INT64_MAX);
+	std::vector<int> parent(cellCount, -1);
+	std::vector<bool> closed(cellCount, false);
+
+	/* (estimated total cost, cell), cheapest first */
+	typedef std::pair<int64_t, int> Node;
+	std::priority_queue<Node, std::vector<Node>, std::greater<Node> > open;
+
+	const int startIdx = search.index(start.x, start.y);
+	const int targetIdx = search.index(target.x, target.y);
+
+	cost[startIdx] = 0;
+	open.push(Node(0, startIdx));
+
+	while (!open.empty())
+	{
+		int idx = open.top().second;
+		open.pop();
+
+		if (closed[idx])
+			continue;
+
+		if (idx == targetIdx)
+			break;
+
+		closed[idx] = true;
+
+		int x = idx % grid.width;
+		int y = idx / grid.width;
+
+		for (int i = 0; i < (query.diagonal ? 8 : 4); ++i)
+		{
+			int nx, ny, stepCost;
+
+			if (i < 4)
+			{
+				const Step &step = straightSteps[i];
+
+				if (!search.canStep(x, y, step))
+					continue;
+
+				nx = x + step.dx;
+				ny = y + step.dy;
+				stepCost = STRAIGHT_COST;
+			}
+			else
+			{
+				/* Left/right combined with down/up */
+				const Step &h = straightSteps[1 + (i & 1)];
+				const Step &v = straightSteps[(i & 2) ? 3 : 0];
+
+				if (!search.canStepDiagonal(x, y, h, v))
+					continue;
+
+				nx = x + h.dx;
+				ny = y + v.dy;
+				stepCost = DIAGONAL_COST;
+			}
+
+			int nIdx = search.index(nx, ny);
+
+			if (closed[nIdx])
+				continue;
+
+			int64_t newCost = cost[idx] + (int64_t) stepCost * grid.costs[nIdx];
+
+			if (newCost >= cost[nIdx])
+				continue;
+
+			cost[nIdx] = newCost;
+			parent[nIdx] = idx;
+
+			int dx = abs(target.x - nx);
+			int dy = abs(target.y - ny);
+			int64_t estimate;
+
+			if (query.diagonal)
+				estimate = STRAIGHT_COST * std::max(dx, dy)
+				         + (DIAGONAL_COST - STRAIGHT_COST) * std::min(dx, dy);
+			else
+				estimate = STRAIGHT_COST * (dx + dy);
+
+			open.push(Node(newCost + estimate * minCost, nIdx));
+		}
+	}
+
+	if (parent[targetIdx] < 0)
+		return false;
+
+	for (int idx = targetIdx; idx != startIdx; idx = parent[idx])
+		path.push_back(Vec2i(idx % grid.width, idx / grid.width));
+
+	std::reverse(path.begin(), path.end());
+
+	return true;
+}
+
+struct PathfinderPrivate
+{
+	struct Job
+	{
+		int id;
+		Pathfinder::Query query;
+	};
+
+	struct Result
+	{
+		bool found;
+		Pathfinder::Path path;
+	};
+
+	SDL_Thread *thread;
+
+	/* Protects everything below */
+	SDL_mutex *mutex;
+	/* Signaled when a job is queued / on shutdown */
+	SDL_cond *workCond;
+
+	std::deque<Job> queue;
+	/* By id, so the oldest ones come first */
+	std::map<int, Result> results;
+
+	/* Id of the job being worked on, or -1 */
+	int current;
+	/* Whether the current job's result is to be discarded */
+	bool currentCancelled;
+	int nextId;
+	bool quit;
+
+	PathfinderPrivate()
+	    : thread(0),
+	      current(-1),
+	      currentCancelled(false),
+	      nextId(0),
+	      quit(false)
+	{
+		mutex = SDL_CreateMutex();
+		workCond = SDL_CreateCond();
+	}
+
+	~PathfinderPrivate()
+	{
+		SDL_DestroyCond(workCond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	/* Called with the mutex held */
+	void storeResult(int id, Result &result)
+	{
+		Result &stored = results[id];
+		stored.found = result.found;
+		stored.path.swap(result.path);
+
+		while (results.size() > MAX_UNPOLLED_RESULTS)
+			results.erase(results.begin());
+	}
+
+	void workerFun()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (queue.empty() && !quit)
+				SDL_CondWait(workCond, mutex);
+
+			if (quit)
+				break;
+
+			Job job;
+			job.id = queue.front().id;
+			std::swap(job.query, queue.front().query);
+			queue.pop_front();
+
+			current = job.id;
+
+			SDL_UnlockMutex(mutex);
+
+			Result result;
+			result.found = Pathfinder::find(job.query, result.path);
+
+			SDL_LockMutex(mutex);
+
+			if (!currentCancelled)
+				storeResult(job.id, result);
+
+			current = -1;
+			currentCancelled = false;
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+Pathfinder::Pathfinder()
+{
+	p = new PathfinderPrivate;
+}
+
+Pathfinder::~Pathfinder()
+{
+	SDL_LockMutex(p->mutex);
+	p->quit = true;
+	SDL_CondSignal(p->workCond);
+	SDL_UnlockMutex(p->mutex);
+
+	if (p->thread)
+		SDL_WaitThread(p->thread, 0);
+
+	delete p;
+}
+
+int Pathfinder::request(const Query &query)
+{
+	/* Most games never ask, so only start the worker on demand */
+	if (!p->thread)
+		p->thread = createSDLThread<PathfinderPrivate, &PathfinderPrivate::workerFun>
+			(p, "pathfinder");
+
+	if (!p->thread)
+	{
+		PathfinderPrivate::Result result;
+		result.found = find(query, result.path);
+
+		SDL_LockMutex(p->mutex);
+		int id = p->nextId++;
+		p->storeResult(id, result);
+		SDL_UnlockMutex(p->mutex);
+
+		return id;
+	}
+
+	SDL_LockMutex(p->mutex);
+
+	int id = p->nextId++;
+
+	p->queue.push_back(PathfinderPrivate::Job());
+	p->queue.back().id = id;
+	p->queue.back().query = query;
+
+	SDL_CondSignal(p->workCond);
+	SDL_UnlockMutex(p->mutex);
+
+	return id;
+}
+
+Pathfinder::Status Pathfinder::poll(int id, Path &path)
+{
+	SDL_LockMutex(p->mutex);
+
+	Status status = Unknown;
+
+	std::map<int, PathfinderPrivate::Result>::iterator iter = p->results.find(id);
+
+	if (iter != p->results.end())
+	{
+		PathfinderPrivate::Result &result = iter->second;
+
+		status = result.found ? Found : NotFound;
+		path.swap(result.path);
+
+		p->results.erase(iter);
+	}
+	else if (id == p->current && !p->currentCancelled)
+	{
+		status = Pending;
+	}
+	else
+	{
+		for (size_t i = 0; i < p->queue.size(); ++i)
+			if (p->queue[i].id == id)
+			{
+				status = Pending;
+				break;
+			}
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return status;
+}
+
+bool Pathfinder::cancel(int id)
+{
+	SDL_LockMutex(p->mutex);
+
+	bool known = false;
+
+	if (p->results.erase(id) > 0)
+	{
+		known = true;
+	}
+	else if (id == p->current && !p->currentCancelled)
+	{
+		/* Can't be stopped midway, but its result won't be kept */
+		p->currentCancelled = true;
+		known = true;
+	}
+	else
+	{
+		for (size_t i = 0; i < p->queue.size(); ++i)
+			if (p->queue[i].id == id)
+			{
+				p->queue.erase(p->queue.begin() + i);
+				known = true;
+				break;
+			}
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return known;
+}
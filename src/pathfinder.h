@@ -0,0 +1,109 @@
+/*
+** pathfinder.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include "etc-internal.h"
+
+#include <stdint.h>
+#include <vector>
+
+struct PathfinderPrivate;
+
+/* A* searches on tile grids, either right away
+ * or queued up for a background thread */
+class Pathfinder
+{
+public:
+	/* Directions a cell can't be left towards,
+	 * using the RMXP tileset passage bits */
+	enum Blocked
+	{
+		BlockedDown  = 0x01,
+		BlockedLeft  = 0x02,
+		BlockedRight = 0x04,
+		BlockedUp    = 0x08
+	};
+
+	struct Grid
+	{
+		int width, height;
+
+		/* Cost of entering a cell, impassable if <= 0 */
+		std::vector<int> costs;
+		/* Blocked direction bits for each cell */
+		std::vector<uint8_t> blocked;
+
+		Grid()
+		    : width(0), height(0)
+		{}
+	};
+
+	struct Query
+	{
+		Grid grid;
+		Vec2i start;
+		Vec2i target;
+		/* Allow diagonal steps (only where one of the
+		 * two orthogonal detours is passable too) */
+		bool diagonal;
+
+		Query()
+		    : diagonal(false)
+		{}
+	};
+
+	/* Cells visited after 'start', ending with 'target' */
+	typedef std::vector<Vec2i> Path;
+
+	enum Status
+	{
+		Pending,
+		Found,
+		NotFound,
+		Unknown
+	};
+
+	Pathfinder();
+	~Pathfinder();
+
+	/* Returns whether 'target' is reachable */
+	static bool find(const Query &query, Path &path);
+
+	/* Queues 'query' for the worker thread,
+	 * returns an id to poll() the result with */
+	int request(const Query &query);
+
+	/* Once a request is done (Found / NotFound), its
+	 * result is handed out once and then forgotten.
+	 * Only the most recent unpolled results are kept */
+	Status poll(int id, Path &path);
+
+	/* Forgets about a request, whether it is done or not.
+	 * Returns false if there was no such request (anymore) */
+	bool cancel(int id);
+
+private:
+	PathfinderPrivate *p;
+};
+
+#endif // PATHFINDER_H
@@ -85,9 +85,18 @@ struct PlanePrivate
 		prepareCon.disconnect();
 	}
 
+	/* Can the bitmap be drawn as one repeating texture? */
+	bool useRepeat() const
+	{
+		if (!gl.npot_repeat)
+			return false;
+
+		return nullOrDisposed(bitmap) || !bitmap->isMega();
+	}
+
 	void updateQuadSource()
 	{
-		if (gl.npot_repeat)
+		if (useRepeat())
 		{
 			FloatRect srcRect;
 			srcRect.x = (sceneGeo.orig.x + ox) / zoomX;
@@ -95,7 +104,8 @@ struct PlanePrivate
 			srcRect.w = sceneGeo.rect.w / zoomX;
 			srcRect.h = sceneGeo.rect.h / zoomY;
 
-			Quad::setTexRect(&qArray.vertices[0], srcRect);
+			qArray.resize(1);
+			Quad::setTexPosRect(&qArray.vertices[0], srcRect, FloatRect(sceneGeo.rect));
 			qArray.commit();
 
 			return;
@@ -120,6 +130,37 @@ struct PlanePrivate
 		size_t tilesX = ceil((vpw - sw + wox) / sw) + 1;
 		size_t tilesY = ceil((vph - sh + woy) / sh) + 1;
 
+		if (bitmap->isMega())
+		{
+			/* Each repetition is made up of one quad per bitmap
+			 * tile; quads are grouped by tile so every tile
+			 * can be drawn with a single call */
+			const std::vector<Bitmap::Tile> &bmTiles = bitmap->getTiles();
+			const size_t reps = tilesX * tilesY;
+
+			qArray.resize(bmTiles.size() * reps);
+
+			for (size_t i = 0; i < bmTiles.size(); ++i)
+			{
+				const IntRect &tr = bmTiles[i].rect;
+				FloatRect tex(0, 0, tr.w, tr.h);
+
+				for (size_t y = 0; y < tilesY; ++y)
+					for (size_t x = 0; x < tilesX; ++x)
+					{
+						SVertex *vert = &qArray.vertices[(i*reps + y*tilesX + x) * 4];
+						FloatRect pos(x*sw - wox + tr.x*zoomX, y*sh - woy + tr.y*zoomY,
+						              tr.w*zoomX, tr.h*zoomY);
+
+						Quad::setTexPosRect(vert, tex, pos);
+					}
+			}
+
+			qArray.commit();
+
+			return;
+		}
+
 		FloatRect tex = bitmap->rect();
 
 		qArray.resize(tilesX * tilesY);
@@ -176,10 +217,9 @@ void Plane::setBitmap(Bitmap *value)
 
 	p->bitmap = value;
 
-	if (!value)
-		return;
-
-	value->ensureNonMega();
+	/* Switching between regular and mega bitmaps
+	 * changes the quad layout */
+	p->quadSourceDirty = true;
 }
 
 void Plane::setOX(int value)
@@ -287,24 +327,35 @@ void Plane::draw()
 
 	glState.blendMode.pushSet(p->blendType);
 
-	p->bitmap->bindTex(*base);
+	if (p->bitmap->isMega())
+	{
+		const std::vector<Bitmap::Tile> &tiles = p->bitmap->getTiles();
+		const size_t reps = p->qArray.count() / tiles.size();
 
-	if (gl.npot_repeat)
-		TEX::setRepeat(true);
+		for (size_t i = 0; i < tiles.size(); ++i)
+		{
+			tiles[i].bitmap->bindTex(*base);
+			p->qArray.draw(i*reps, reps);
+		}
+	}
+	else
+	{
+		p->bitmap->bindTex(*base);
 
-	p->qArray.draw();
+		if (gl.npot_repeat)
+			TEX::setRepeat(true);
 
-	if (gl.npot_repeat)
-		TEX::setRepeat(false);
+		p->qArray.draw();
+
+		if (gl.npot_repeat)
+			TEX::setRepeat(false);
+	}
 
 	glState.blendMode.pop();
 }
 
 void Plane::onGeometryChange(const Scene::Geometry &geo)
 {
-	if (gl.npot_repeat)
-		Quad::setPosRect(&p->qArray.vertices[0], FloatRect(geo.rect));
-
 	p->sceneGeo = geo;
 	p->quadSourceDirty = true;
 }
@@ -25,6 +25,19 @@
 #include <stdint.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 struct RGSS_entryData
 {
 	int64_t offset;
@@ -32,31 +45,83 @@ struct RGSS_entryData
 	uint32_t startMagic;
 };
 
+/* Size of the decrypted read-ahead buffer each open
+ * entry keeps, so small reads don't hit the archive */
+#define RGSS_BUFFER_SIZE 0x4000
+
 struct RGSS_entryHandle
 {
 	const RGSS_entryData data;
-	uint32_t currentMagic;
 	uint64_t currentOffset;
+
+	/* Points to the entry contents if the archive is memory
+	 * mapped, in which case there is no 'io' */
+	const uint8_t *mapped;
 	PHYSFS_Io *io;
 
-	RGSS_entryHandle(const RGSS_entryData &data, PHYSFS_Io *archIo)
+	/* Offset (always dword aligned) the keystream (and archive
+	 * io) is positioned at, and the magic of the dword there */
+	uint64_t keyOffset;
+	uint32_t keyMagic;
+
+	/* Decrypted entry bytes starting at 'bufferOffset'
+	 * (dword aligned) */
+	uint8_t buffer[RGSS_BUFFER_SIZE];
+	uint64_t bufferOffset;
+	uint64_t bufferLen;
+
+	RGSS_entryHandle(const RGSS_entryData &data,
+	                 PHYSFS_Io *archIo, const uint8_t *mapping)
 	    : data(data),
-	      currentMagic(data.startMagic),
 	      currentOffset(0)
 	{
-		io = archIo->duplicate(archIo);
+		init(archIo, mapping ? mapping + data.offset : 0);
+	}
+
+	RGSS_entryHandle(const RGSS_entryHandle &other)
+	    : data(other.data),
+	      currentOffset(other.currentOffset)
+	{
+		init(other.io, other.mapped);
 	}
 
 	~RGSS_entryHandle()
 	{
-		io->destroy(io);
+		if (io)
+			io->destroy(io);
+	}
+
+private:
+	void init(PHYSFS_Io *srcIo, const uint8_t *srcMapped)
+	{
+		mapped = srcMapped;
+		io = 0;
+
+		if (!mapped)
+		{
+			io = srcIo->duplicate(srcIo);
+			io->seek(io, data.offset);
+		}
+
+		keyOffset = 0;
+		keyMagic = data.startMagic;
+
+		bufferOffset = 0;
+		bufferLen = 0;
 	}
 };
 
+static void
+unmapArchive(const uint8_t *mapping, uint64_t size);
+
 struct RGSS_archiveData
 {
 	PHYSFS_Io *archiveIo;
 
+	/* The whole archive file, if it could be mapped */
+	const uint8_t *mapping;
+	uint64_t mappingSize;
+
 	/* Maps: file path
 	 * to:   entry data */
 	BoostHash<std::string, RGSS_entryData> entryHash;
@@ -64,6 +129,12 @@ struct RGSS_archiveData
 	/* Maps: directory path,
 	 * to:   list of contained entries */
 	BoostHash<std::string, BoostSet<std::string> > dirHash;
+
+	~RGSS_archiveData()
+	{
+		if (mapping)
+			unmapArchive(mapping, mappingSize);
+	}
 };
 
 static bool
@@ -98,100 +169,241 @@ advanceMagic(uint32_t &magic)
 	return old;
 }
 
-static PHYSFS_sint64
-RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
+/* Returns the magic 'count' dwords past 'magic', stepping
+ * through powers of the affine map in log(count) time */
+static uint32_t
+skipMagic(uint32_t magic, uint64_t count)
 {
-	RGSS_entryHandle *entry = static_cast<RGSS_entryHandle*>(self->opaque);
+	uint32_t mul = 7;
+	uint32_t add = 3;
 
-	PHYSFS_Io *io = entry->io;
+	while (count > 0)
+	{
+		if (count & 1)
+			magic = magic * mul + add;
 
-	uint64_t toRead = std::min<uint64_t>(entry->data.size - entry->currentOffset, len);
-	uint64_t offs = entry->currentOffset;
+		add = add * (mul + 1);
+		mul = mul * mul;
+		count >>= 1;
+	}
 
-	io->seek(io, entry->data.offset + offs);
-
-	/* We divide up the bytes to be read in 3 categories:
-	 *
-	 * preAlign: If the current read address is not dword
-	 *   aligned, this is the number of bytes to read til
-	 *   we reach alignment again (therefore can only be
-	 *   3 or less).
-	 *
-	 * align: The number of aligned dwords we can read
-	 *   times 4 (= number of bytes).
-	 *
-	 * postAlign: The number of bytes to read after the
-	 *   last aligned dword. Always 3 or less.
-	 *
-	 * Treating the pre- and post aligned reads specially,
-	 * we can read all aligned dwords in one syscall directly
-	 * into the write buffer and then run the xor chain on
-	 * it afterwards. */
-
-	uint8_t preAlign = 4 - (offs % 4);
-
-	if (preAlign == 4)
-		preAlign = 0;
-	else
-		preAlign = std::min<uint64_t>(preAlign, len);
+	return magic;
+}
 
-	uint8_t postAlign = (len > preAlign) ? (offs + len) % 4 : 0;
+#ifdef __SSE2__
+/* Four steps of the magic at once: m * 7^4 + 3 * (1+7+7^2+7^3).
+ * SSE2 has no 32 bit multiply, so 2401 is split into shifts */
+static inline __m128i
+advanceMagic4(__m128i magic)
+{
+	/* 2401 = 2^11 + 2^8 + 2^6 + 2^5 + 1 */
+	__m128i result = _mm_add_epi32(magic, _mm_slli_epi32(magic, 5));
+	result = _mm_add_epi32(result, _mm_slli_epi32(magic, 6));
+	result = _mm_add_epi32(result, _mm_slli_epi32(magic, 8));
+	result = _mm_add_epi32(result, _mm_slli_epi32(magic, 11));
 
-	uint64_t align = len - (preAlign + postAlign);
+	return _mm_add_epi32(result, _mm_set1_epi32(1200));
+}
+#endif
 
-	/* Byte buffer pointer */
-	uint8_t *bBufferP = static_cast<uint8_t*>(buffer);
+/* Decrypts 'len' bytes starting at a dword boundary, 'magic' being
+ * the key of the first dword. 'magic' is advanced past all complete
+ * dwords; a trailing partial dword can only occur at the entry end */
+static void
+xorKeystream(uint8_t *data, uint64_t len, uint32_t &magic)
+{
+	uint64_t i = 0;
 
-	if (preAlign > 0)
+#ifdef __SSE2__
+	if (len >= 16)
+	{
+		uint32_t m0 = magic;
+		uint32_t m1 = m0 * 7 + 3;
+		uint32_t m2 = m1 * 7 + 3;
+		uint32_t m3 = m2 * 7 + 3;
+
+		__m128i keys = _mm_set_epi32(m3, m2, m1, m0);
+
+		for (; i + 16 <= len; i += 16)
+		{
+			__m128i *p = reinterpret_cast<__m128i*>(data + i);
+
+			_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), keys));
+			keys = advanceMagic4(keys);
+		}
+
+		magic = _mm_cvtsi128_si32(keys);
+	}
+#endif
+
+	for (; i + 4 <= len; i += 4)
 	{
 		uint32_t dword;
-		io->read(io, &dword, preAlign);
+		memcpy(&dword, data + i, 4);
+		dword ^= advanceMagic(magic);
+		memcpy(data + i, &dword, 4);
+	}
+
+	if (i < len)
+	{
+		uint32_t dword = 0;
+		memcpy(&dword, data + i, len - i);
+		dword ^= magic;
+		memcpy(data + i, &dword, len - i);
+	}
+}
 
-		/* Need to align the bytes with the
-		 * magic before xoring */
-		dword <<= 8 * (offs % 4);
-		dword ^= entry->currentMagic;
+/* Positions the keystream at the dword aligned 'offset' */
+static void
+seekKeystream(RGSS_entryHandle *entry, uint64_t offset)
+{
+	if (offset == entry->keyOffset)
+		return;
 
-		/* Shift them back to normal */
-		dword >>= 8 * (offs % 4);
-		memcpy(bBufferP, &dword, preAlign);
+	if (offset > entry->keyOffset)
+		entry->keyMagic = skipMagic(entry->keyMagic, (offset - entry->keyOffset) / 4);
+	else
+		entry->keyMagic = skipMagic(entry->data.startMagic, offset / 4);
+
+	entry->keyOffset = offset;
+}
 
-		bBufferP += preAlign;
+/* Reads and decrypts 'len' bytes at the dword aligned 'offset' into
+ * 'dest', only seeking the archive if it isn't positioned there yet */
+static uint64_t
+readDecrypted(RGSS_entryHandle *entry, uint64_t offset,
+              uint8_t *dest, uint64_t len)
+{
+	PHYSFS_Io *io = entry->io;
 
-		/* Only advance the magic if we actually
-		 * reached the next alignment */
-		if ((offs+preAlign) % 4 == 0)
-			advanceMagic(entry->currentMagic);
+	if (offset != entry->keyOffset)
+	{
+		seekKeystream(entry, offset);
+		io->seek(io, entry->data.offset + offset);
 	}
 
-	if (align > 0)
+	PHYSFS_sint64 count = io->read(io, dest, len);
+
+	if (count <= 0)
+		return 0;
+
+	xorKeystream(dest, count, entry->keyMagic);
+	entry->keyOffset += count;
+
+	/* Keep the keystream in sync with the io on short reads */
+	if (count % 4)
 	{
-		/* Double word buffer pointer */
-		uint32_t *dwBufferP = reinterpret_cast<uint32_t*>(bBufferP);
+		entry->keyOffset -= count % 4;
+		io->seek(io, entry->data.offset + entry->keyOffset);
+	}
+
+	return count;
+}
 
-		/* Read aligned dwords in one go */
-		io->read(io, bBufferP, align);
+/* Copies and decrypts straight out of the mapped archive */
+static void
+readMapped(RGSS_entryHandle *entry, uint8_t *dest, uint64_t len)
+{
+	uint64_t offs = entry->currentOffset;
+	uint8_t head = offs % 4;
 
-		/* Then xor them */
-		for (uint64_t i = 0; i < (align / 4); ++i)
-			dwBufferP[i] ^= advanceMagic(entry->currentMagic);
+	memcpy(dest, entry->mapped + offs, len);
+	seekKeystream(entry, offs - head);
+
+	/* Bytes in front of the next dword boundary have to
+	 * be aligned with the magic before xoring */
+	if (head > 0)
+	{
+		uint8_t count = std::min<uint64_t>(4 - head, len);
+		uint32_t dword = 0;
 
-		bBufferP += align;
+		memcpy(reinterpret_cast<uint8_t*>(&dword) + head, dest, count);
+		dword ^= entry->keyMagic;
+		memcpy(dest, reinterpret_cast<uint8_t*>(&dword) + head, count);
+
+		if (head + count < 4)
+			return;
+
+		advanceMagic(entry->keyMagic);
+		entry->keyOffset += 4;
+
+		dest += count;
+		len -= count;
 	}
 
-	if (postAlign > 0)
+	uint32_t magic = entry->keyMagic;
+	xorKeystream(dest, len, magic);
+
+	/* Only complete dwords move the keystream along */
+	entry->keyMagic = magic;
+	entry->keyOffset += len & ~(uint64_t) 3;
+}
+
+static PHYSFS_sint64
+RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
+{
+	RGSS_entryHandle *entry = static_cast<RGSS_entryHandle*>(self->opaque);
+
+	uint64_t toRead = std::min<uint64_t>(entry->data.size - entry->currentOffset, len);
+	uint8_t *dest = static_cast<uint8_t*>(buffer);
+	uint64_t done = 0;
+
+	if (entry->mapped)
 	{
-		uint32_t dword;
-		io->read(io, &dword, postAlign);
+		readMapped(entry, dest, toRead);
+		entry->currentOffset += toRead;
 
-		/* Bytes are already aligned with magic */
-		dword ^= entry->currentMagic;
-		memcpy(bBufferP, &dword, postAlign);
+		return toRead;
 	}
 
-	entry->currentOffset += toRead;
+	while (done < toRead)
+	{
+		uint64_t offs = entry->currentOffset;
+		uint64_t remaining = toRead - done;
+
+		/* Serve what we can from the read-ahead buffer */
+		if (offs >= entry->bufferOffset &&
+		    offs < entry->bufferOffset + entry->bufferLen)
+		{
+			uint64_t count = std::min<uint64_t>(remaining,
+			        entry->bufferOffset + entry->bufferLen - offs);
+
+			memcpy(dest + done, entry->buffer + (offs - entry->bufferOffset), count);
+			entry->currentOffset += count;
+			done += count;
+
+			continue;
+		}
+
+		/* Large aligned reads are decrypted in place */
+		if (remaining >= RGSS_BUFFER_SIZE && offs % 4 == 0)
+		{
+			if (offs + remaining < entry->data.size)
+				remaining &= ~(uint64_t) 3;
+
+			uint64_t count = readDecrypted(entry, offs, dest + done, remaining);
+
+			if (count == 0)
+				break;
+
+			entry->currentOffset += count;
+			done += count;
+
+			continue;
+		}
+
+		uint64_t bufferOffset = offs & ~(uint64_t) 3;
+		uint64_t bufferLen = std::min<uint64_t>(RGSS_BUFFER_SIZE,
+		                                        entry->data.size - bufferOffset);
+
+		entry->bufferOffset = bufferOffset;
+		entry->bufferLen = readDecrypted(entry, bufferOffset, entry->buffer, bufferLen);
+
+		if (offs >= entry->bufferOffset + entry->bufferLen)
+			break;
+	}
 
-	return toRead;
+	return done;
 }
 
 static int
@@ -205,23 +417,8 @@ RGSS_ioSeek(PHYSFS_Io *self, PHYSFS_uint64 offset)
 	if (offset > entry->data.size-1)
 		return 0;
 
-	/* If rewinding, we need to rewind to begining */
-	if (offset < entry->currentOffset)
-	{
-		entry->currentOffset = 0;
-		entry->currentMagic = entry->data.startMagic;
-	}
-
-	/* For each overstepped alignment, advance magic */
-	uint64_t currentDword = entry->currentOffset / 4;
-	uint64_t targetDword  = offset / 4;
-	uint64_t dwordsSought = targetDword - currentDword;
-
-	for (uint64_t i = 0; i < dwordsSought; ++i)
-		advanceMagic(entry->currentMagic);
-
+	/* The keystream is repositioned lazily on the next read */
 	entry->currentOffset = offset;
-	entry->io->seek(entry->io, entry->data.offset + entry->currentOffset);
 
 	return 1;
 }
@@ -332,8 +529,97 @@ verifyHeader(PHYSFS_Io *io, char version)
 	return true;
 }
 
+/* Maps the archive file at 'path' into memory, so entries can be
+ * read without any syscalls. Returns null if that isn't possible,
+ * or the file doesn't look like the archive 'io' refers to */
+static const uint8_t *
+mapArchive(const char *path, uint64_t size)
+{
+	if (!path || size < sizeof(RGSS_HEADER))
+		return 0;
+
+	void *mem = 0;
+
+#ifdef _WIN32
+	wchar_t widePath[MAX_PATH];
+
+	if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath, MAX_PATH))
+		return 0;
+
+	HANDLE file = CreateFileW(widePath, GENERIC_READ, FILE_SHARE_READ, 0,
+	                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return 0;
+
+	LARGE_INTEGER fileSize;
+	HANDLE mappingObj = 0;
+
+	if (GetFileSizeEx(file, &fileSize) && (uint64_t) fileSize.QuadPart == size)
+		mappingObj = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+
+	/* The view keeps the file mapped after closing the handles */
+	if (mappingObj)
+	{
+		mem = MapViewOfFile(mappingObj, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mappingObj);
+	}
+
+	CloseHandle(file);
+#else
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return 0;
+
+	struct stat st;
+
+	if (fstat(fd, &st) == 0 && (uint64_t) st.st_size == size)
+	{
+		mem = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (mem == MAP_FAILED)
+			mem = 0;
+	}
+
+	close(fd);
+#endif
+
+	const uint8_t *mapping = static_cast<const uint8_t*>(mem);
+
+	if (mapping && memcmp(mapping, RGSS_HEADER, sizeof(RGSS_HEADER)-1) != 0)
+	{
+		unmapArchive(mapping, size);
+		return 0;
+	}
+
+	return mapping;
+}
+
+static void
+unmapArchive(const uint8_t *mapping, uint64_t size)
+{
+#ifdef _WIN32
+	(void) size;
+	UnmapViewOfFile(mapping);
+#else
+	munmap(const_cast<uint8_t*>(mapping), size);
+#endif
+}
+
+static RGSS_archiveData *
+createArchiveData(PHYSFS_Io *io, const char *filename)
+{
+	RGSS_archiveData *data = new RGSS_archiveData;
+	data->archiveIo = io;
+	data->mappingSize = io->length(io);
+	data->mapping = mapArchive(filename, data->mappingSize);
+
+	return data;
+}
+
 static void*
-RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
+RGSS_openArchive(PHYSFS_Io *io, const char *filename, int forWrite, int *claimed)
 {
 	if (forWrite)
 		return NULL;
@@ -344,8 +630,7 @@ RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
 	else
 		*claimed = 1;
 
-	RGSS_archiveData *data = new RGSS_archiveData;
-	data->archiveIo = io;
+	RGSS_archiveData *data = createArchiveData(io, filename);
 
 	uint32_t magic = RGSS_MAGIC;
 
@@ -422,8 +707,17 @@ RGSS_openRead(void *opaque, const char *filename)
 	if (!data->entryHash.contains(filename))
 		return 0;
 
+	const RGSS_entryData &entryData = data->entryHash[filename];
+
+	/* Entries reaching past the end of a (corrupt) archive
+	 * are left to the io to deal with */
+	const uint8_t *mapping = data->mapping;
+
+	if (entryData.offset + entryData.size > data->mappingSize)
+		mapping = 0;
+
 	RGSS_entryHandle *entry =
-	        new RGSS_entryHandle(data->entryHash[filename], data->archiveIo);
+	        new RGSS_entryHandle(entryData, data->archiveIo, mapping);
 
 	PHYSFS_Io *io = PHYSFS_ALLOC(PHYSFS_Io);
 
@@ -542,7 +836,7 @@ readUint32AndXor(PHYSFS_Io *io, uint32_t &result, uint32_t key)
 }
 
 static void*
-RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
+RGSS3_openArchive(PHYSFS_Io *io, const char *filename, int forWrite, int *claimed)
 {
 	if (forWrite)
 		return NULL;
@@ -560,8 +854,7 @@ RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
 
 	baseMagic = (baseMagic * 9) + 3;
 
-	RGSS_archiveData *data = new RGSS_archiveData;
-	data->archiveIo = io;
+	RGSS_archiveData *data = createArchiveData(io, filename);
 
 	/* Top level entry list */
 	BoostSet<std::string> &topLevel = data->dirHash[""];
@@ -0,0 +1,326 @@
+/*
+** savewriter.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "savewriter.h"
+
+#include "debugwriter.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+
+#include <deque>
+#include <string>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static std::wstring
+widePath(const std::string &path)
+{
+	int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, 0, 0);
+
+	if (len <= 0)
+		return std::wstring();
+
+	std::wstring result(len, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &result[0], len);
+	result.resize(len-1);
+
+	return result;
+}
+#endif
+
+/* Some failures leave errno unset */
+static int
+lastError()
+{
+	return errno ? errno : EIO;
+}
+
+/* Creates the temporary file 'tmpName'.
+ * Returns 0, or the errno value on failure */
+static int
+openTemp(const std::string &tmpName, FILE *&f)
+{
+#ifdef _WIN32
+	f = _wfopen(widePath(tmpName).c_str(), L"wb");
+#else
+	f = fopen(tmpName.c_str(), "wb");
+#endif
+
+	if (!f)
+		return lastError();
+
+	return 0;
+}
+
+/* Writes and syncs 'data' to the temporary file 'f' (closing it),
+ * then renames it from 'tmpName' over 'filename'. Returns 0, or
+ * the errno value of the first step that failed */
+static int
+finishAtomic(FILE *f, const std::string &tmpName,
+             const std::string &filename, const std::string &data)
+{
+	int err = 0;
+
+	if (fwrite(data.c_str(), 1, data.size(), f) != data.size() || fflush(f) != 0)
+		err = lastError();
+
+#ifdef _WIN32
+	if (!err && _commit(_fileno(f)) != 0)
+		err = lastError();
+#else
+	if (!err && fsync(fileno(f)) != 0)
+		err = lastError();
+#endif
+
+	if (fclose(f) != 0 && !err)
+		err = lastError();
+
+	if (!err)
+	{
+#ifdef _WIN32
+		if (!MoveFileExW(widePath(tmpName).c_str(), widePath(filename).c_str(),
+		                 MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+			err = EIO;
+#else
+		if (rename(tmpName.c_str(), filename.c_str()) != 0)
+			err = lastError();
+#endif
+	}
+
+	if (err)
+	{
+#ifdef _WIN32
+		_wremove(widePath(tmpName).c_str());
+#else
+		remove(tmpName.c_str());
+#endif
+	}
+
+	return err;
+}
+
+struct SaveWriterPrivate
+{
+	struct Job
+	{
+		std::string filename;
+		std::string data;
+		/* The already created temporary file */
+		std::string tmpName;
+		FILE *file;
+	};
+
+	SDL_Thread *thread;
+
+	/* Protects everything below */
+	SDL_mutex *mutex;
+	/* Signaled when a job is queued / on shutdown */
+	SDL_cond *workCond;
+	/* Signaled when a job is done */
+	SDL_cond *doneCond;
+
+	std::deque<Job> queue;
+	/* Whether the writer is currently busy with a job */
+	bool writing;
+	/* Keeps temporary files of queued saves to the same file apart */
+	unsigned int tmpCounter;
+	bool quit;
+
+	/* First failure since the last takeError() */
+	int error;
+	std::string errorFile;
+
+	SaveWriterPrivate()
+	    : thread(0),
+	      writing(false),
+	      tmpCounter(0),
+	      quit(false),
+	      error(0)
+	{
+		mutex = SDL_CreateMutex();
+		workCond = SDL_CreateCond();
+		doneCond = SDL_CreateCond();
+	}
+
+	~SaveWriterPrivate()
+	{
+		SDL_DestroyCond(doneCond);
+		SDL_DestroyCond(workCond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	/* Call with 'mutex' held */
+	void setError(int err, const std::string &filename)
+	{
+		Debug() << "Failed to write save file" << filename << ":" << strerror(err);
+
+		if (error)
+			return;
+
+		error = err;
+		errorFile = filename;
+	}
+
+	void writerFun()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (queue.empty() && !quit)
+				SDL_CondWait(workCond, mutex);
+
+			/* Pending saves are still written on shutdown */
+			if (queue.empty())
+				break;
+
+			Job job;
+			job.filename.swap(queue.front().filename);
+			job.data.swap(queue.front().data);
+			job.tmpName.swap(queue.front().tmpName);
+			job.file = queue.front().file;
+			queue.pop_front();
+
+			writing = true;
+
+			SDL_UnlockMutex(mutex);
+
+			int err = finishAtomic(job.file, job.tmpName, job.filename, job.data);
+
+			SDL_LockMutex(mutex);
+
+			writing = false;
+
+			if (err)
+				setError(err, job.filename);
+
+			SDL_CondBroadcast(doneCond);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+SaveWriter::SaveWriter()
+{
+	p = new SaveWriterPrivate;
+	p->thread = createSDLThread<SaveWriterPrivate, &SaveWriterPrivate::writerFun>
+		(p, "savewriter");
+}
+
+SaveWriter::~SaveWriter()
+{
+	SDL_LockMutex(p->mutex);
+	p->quit = true;
+	SDL_CondSignal(p->workCond);
+	SDL_UnlockMutex(p->mutex);
+
+	if (p->thread)
+		SDL_WaitThread(p->thread, 0);
+
+	delete p;
+}
+
+int SaveWriter::write(const char *filename, const void *data, size_t size)
+{
+	SaveWriterPrivate::Job job;
+	job.filename = filename;
+
+	SDL_LockMutex(p->mutex);
+	unsigned int tmpId = p->tmpCounter++;
+	SDL_UnlockMutex(p->mutex);
+
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%u.tmp", tmpId);
+	job.tmpName = job.filename + suffix;
+
+	/* Problems with the location itself show up right away */
+	int err = openTemp(job.tmpName, job.file);
+
+	if (err)
+		return err;
+
+	job.data.assign(static_cast<const char*>(data), size);
+
+	/* Without a writer thread, just do it here */
+	if (!p->thread)
+		return finishAtomic(job.file, job.tmpName, job.filename, job.data);
+
+	SDL_LockMutex(p->mutex);
+
+	p->queue.push_back(SaveWriterPrivate::Job());
+	p->queue.back().filename.swap(job.filename);
+	p->queue.back().data.swap(job.data);
+	p->queue.back().tmpName.swap(job.tmpName);
+	p->queue.back().file = job.file;
+
+	SDL_CondSignal(p->workCond);
+	SDL_UnlockMutex(p->mutex);
+
+	return 0;
+}
+
+bool SaveWriter::pending()
+{
+	SDL_LockMutex(p->mutex);
+	bool result = !p->queue.empty() || p->writing;
+	SDL_UnlockMutex(p->mutex);
+
+	return result;
+}
+
+void SaveWriter::wait()
+{
+	SDL_LockMutex(p->mutex);
+
+	while (!p->queue.empty() || p->writing)
+		SDL_CondWait(p->doneCond, p->mutex);
+
+	SDL_UnlockMutex(p->mutex);
+}
+
+bool SaveWriter::takeError(int &error, std::string &filename)
+{
+	SDL_LockMutex(p->mutex);
+
+	bool result = (p->error != 0);
+
+	if (result)
+	{
+		error = p->error;
+		filename.swap(p->errorFile);
+		p->error = 0;
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return result;
+}
@@ -0,0 +1,61 @@
+/*
+** savewriter.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SAVEWRITER_H
+#define SAVEWRITER_H
+
+#include <stddef.h>
+#include <string>
+
+struct SaveWriterPrivate;
+
+/* Writes save files on a background thread, so scripts don't
+ * stall on slow storage. Files are replaced atomically: after a
+ * crash mid-write, the previous contents are still intact.
+ * Errors are reported as errno values */
+class SaveWriter
+{
+public:
+	SaveWriter();
+	/* Finishes all pending writes */
+	~SaveWriter();
+
+	/* Queues 'data' to be written to 'filename' (a native path).
+	 * The temporary file is created right away; if that fails,
+	 * returns the error and nothing is queued. Failures of the
+	 * write itself are reported by takeError() later */
+	int write(const char *filename, const void *data, size_t size);
+
+	/* Whether any writes are queued or in progress */
+	bool pending();
+
+	/* Blocks until all queued writes have finished */
+	void wait();
+
+	/* Returns whether any queued write failed since the last
+	 * call, and if so, the first error and its file */
+	bool takeError(int &error, std::string &filename);
+
+private:
+	SaveWriterPrivate *p;
+};
+
+#endif // SAVEWRITER_H
@@ -25,6 +25,7 @@
 #include "exception.h"
 
 #include <assert.h>
+#include <math.h>
 #include <string.h>
 #include <iostream>
 
@@ -34,6 +35,7 @@
 #include "trans.frag.xxd"
 #include "transSimple.frag.xxd"
 #include "bitmapBlit.frag.xxd"
+#include "bitmapBlitFetch.frag.xxd"
 #include "plane.frag.xxd"
 #include "gray.frag.xxd"
 #include "flatColor.frag.xxd"
@@ -48,6 +50,7 @@
 #include "sprite.vert.xxd"
 #include "tilemap.vert.xxd"
 #include "blur.frag.xxd"
+#include "radialBlur.frag.xxd"
 #include "simpleMatrix.vert.xxd"
 #include "blurH.vert.xxd"
 #include "blurV.vert.xxd"
@@ -60,6 +63,14 @@
 	#vert, #frag, #name); \
 }
 
+/* Same as above, additionally enabling a GLSL
+ * extension in the fragment shader */
+#define INIT_SHADER_EXT(vert, frag, name, ext) \
+{ \
+	Shader::init(shader_##vert##_vert, shader_##vert##_vert_len, shader_##frag##_frag, shader_##frag##_frag_len, \
+	#vert, #frag, #name, #ext); \
+}
+
 #define GET_U(name) u_##name = gl.GetUniformLocation(program, #name)
 
 static void printShaderLog(GLuint shader)
@@ -112,15 +123,29 @@ void Shader::unbind()
 }
 
 static void setupShaderSource(GLuint shader, GLenum type,
-                              const unsigned char *body, int bodySize)
+                              const unsigned char *body, int bodySize,
+                              const char *extension = 0)
 {
 	static const char glesDefine[] = "#define GLSLES\n";
 	static const char fragDefine[] = "#define FRAGMENT_SHADER\n";
 
-	const GLchar *shaderSrc[4];
-	GLint shaderSrcSize[4];
+	const GLchar *shaderSrc[5];
+	GLint shaderSrcSize[5];
 	size_t i = 0;
 
+	/* Extension directives have to precede
+	 * any non-preprocessor token */
+	std::string extDirective;
+
+	if (extension)
+	{
+		extDirective = std::string("#extension ") + extension + " : enable\n";
+
+		shaderSrc[i] = extDirective.c_str();
+		shaderSrcSize[i] = extDirective.size();
+		++i;
+	}
+
 	if (gl.glsles)
 	{
 		shaderSrc[i] = glesDefine;
@@ -149,7 +174,7 @@ static void setupShaderSource(GLuint shader, GLenum type,
 void Shader::init(const unsigned char *vert, int vertSize,
                   const unsigned char *frag, int fragSize,
                   const char *vertName, const char *fragName,
-                  const char *programName)
+                  const char *programName, const char *fragExtension)
 {
 	GLint success;
 
@@ -168,7 +193,7 @@ void Shader::init(const unsigned char *vert, int vertSize,
 	}
 
 	/* Compile fragment shader */
-	setupShaderSource(fragShader, GL_FRAGMENT_SHADER, frag, fragSize);
+	setupShaderSource(fragShader, GL_FRAGMENT_SHADER, frag, fragSize, fragExtension);
 	gl.CompileShader(fragShader);
 
 	gl.GetShaderiv(fragShader, GL_COMPILE_STATUS, &success);
@@ -589,6 +614,35 @@ BlurShader::VPass::VPass()
 }
 
 
+RadialBlurShader::RadialBlurShader()
+{
+	INIT_SHADER(simple, radialBlur, RadialBlurShader);
+
+	ShaderBase::init();
+
+	GET_U(bitmapSize);
+	GET_U(baseRot);
+	GET_U(stepRot);
+	GET_U(samples);
+}
+
+void RadialBlurShader::setBitmapSize(const Vec2 &value)
+{
+	gl.Uniform2f(u_bitmapSize, value.x, value.y);
+}
+
+void RadialBlurShader::setRotation(float baseAngle, float angleStep)
+{
+	gl.Uniform2f(u_baseRot, cosf(baseAngle), sinf(baseAngle));
+	gl.Uniform2f(u_stepRot, cosf(angleStep), sinf(angleStep));
+}
+
+void RadialBlurShader::setSamples(int value)
+{
+	gl.Uniform1i(u_samples, value);
+}
+
+
 TilemapVXShader::TilemapVXShader()
 {
 	INIT_SHADER(tilemapvx, simple, TilemapVXShader);
@@ -635,3 +689,24 @@ void BltShader::setOpacity(float value)
 {
 	gl.Uniform1f(u_opacity, value);
 }
+
+
+BltFetchShader::BltFetchShader()
+{
+	INIT_SHADER_EXT(simple, bitmapBlitFetch, BltFetchShader, GL_EXT_shader_framebuffer_fetch);
+
+	ShaderBase::init();
+
+	GET_U(source);
+	GET_U(opacity);
+}
+
+void BltFetchShader::setSource()
+{
+	gl.Uniform1i(u_source, 0);
+}
+
+void BltFetchShader::setOpacity(float value)
+{
+	gl.Uniform1f(u_opacity, value);
+}
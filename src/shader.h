@@ -46,7 +46,7 @@ protected:
 	void init(const unsigned char *vert, int vertSize,
 	          const unsigned char *frag, int fragSize,
 	          const char *vertName, const char *fragName,
-	          const char *programName);
+	          const char *programName, const char *fragExtension = 0);
 	void initFromFile(const char *vertFile, const char *fragFile,
 	                  const char *programName);
 
@@ -276,6 +276,21 @@ struct BlurShader
 	VPass pass2;
 };
 
+/* Rotational blur, all samples in one pass */
+class RadialBlurShader : public ShaderBase
+{
+public:
+	RadialBlurShader();
+
+	void setBitmapSize(const Vec2 &value);
+	/* Angles in radians */
+	void setRotation(float baseAngle, float angleStep);
+	void setSamples(int value);
+
+private:
+	GLint u_bitmapSize, u_baseRot, u_stepRot, u_samples;
+};
+
 class TilemapVXShader : public ShaderBase
 {
 public:
@@ -303,6 +318,21 @@ private:
 	GLint u_source, u_destination, u_subRect, u_opacity;
 };
 
+/* Bitmap blit reading the destination via
+ * EXT_shader_framebuffer_fetch (only usable
+ * if gl.fb_fetch is set) */
+class BltFetchShader : public ShaderBase
+{
+public:
+	BltFetchShader();
+
+	void setSource();
+	void setOpacity(float value);
+
+private:
+	GLint u_source, u_opacity;
+};
+
 /* Global object containing all available shaders */
 struct ShaderSet
 {
@@ -321,8 +351,10 @@ struct ShaderSet
 	SimpleTransShader simpleTrans;
 	HueShader hue;
 	BltShader blt;
+	BltFetchShader bltFetch;
 	SimpleMatrixShader simpleMatrix;
 	BlurShader blur;
+	RadialBlurShader radialBlur;
 	TilemapVXShader tilemapVX;
 };
 
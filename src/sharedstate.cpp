@@ -23,17 +23,22 @@
 
 #include "util.h"
 #include "filesystem.h"
+#include "imagedecoder.h"
+#include "savewriter.h"
+#include "pathfinder.h"
 #include "graphics.h"
 #include "input.h"
 #include "audio.h"
 #include "glstate.h"
 #include "shader.h"
 #include "texpool.h"
+#include "imagecache.h"
 #include "font.h"
 #include "eventthread.h"
 #include "gl-util.h"
 #include "global-ibo.h"
 #include "quad.h"
+#include "quadarray.h"
 #include "binding.h"
 #include "exception.h"
 #include "sharedmidistate.h"
@@ -66,6 +71,9 @@ struct SharedStatePrivate
 	Scene *screen;
 
 	FileSystem fileSystem;
+	ImageDecoder imageDecoder;
+	SaveWriter saveWriter;
+	Pathfinder pathfinder;
 
 	EventThread &eThread;
 	RGSSThreadData &rtData;
@@ -82,6 +90,7 @@ struct SharedStatePrivate
 	ShaderSet shaders;
 
 	TexPool texPool;
+	ImageCache imageCache;
 
 	SharedFontState fontState;
 	Font *defaultFont;
@@ -95,6 +104,7 @@ struct SharedStatePrivate
 	TEXFBO atlasTex;
 
 	Quad gpQuad;
+	ColorQuadArray gpQuadArray;
 
 	unsigned int stampCounter;
 
@@ -102,6 +112,7 @@ struct SharedStatePrivate
 	    : bindingData(0),
 	      sdlWindow(threadData->window),
 	      fileSystem(threadData->argv0, threadData->config.allowSymlinks),
+	      imageDecoder(fileSystem),
 	      eThread(*threadData->ethread),
 	      rtData(*threadData),
 	      config(threadData->config),
@@ -132,8 +143,11 @@ struct SharedStatePrivate
 		for (size_t i = 0; i < config.rtps.size(); ++i)
 			fileSystem.addPath(config.rtps[i].c_str());
 
-		if (config.pathCache)
-			fileSystem.createPathCache();
+		const std::string &dataPath = config.customDataPath.empty()
+		        ? config.commonDataPath : config.customDataPath;
+
+		fileSystem.setExtensionOrder(config.extensionOrder.c_str());
+		fileSystem.createIndex(config.pathCache, dataPath.c_str());
 
 		fileSystem.initFontSets(fontState);
 
@@ -222,6 +236,9 @@ GSATT(void*, bindingData)
 GSATT(SDL_Window*, sdlWindow)
 GSATT(Scene*, screen)
 GSATT(FileSystem&, fileSystem)
+GSATT(ImageDecoder&, imageDecoder)
+GSATT(SaveWriter&, saveWriter)
+GSATT(Pathfinder&, pathfinder)
 GSATT(EventThread&, eThread)
 GSATT(RGSSThreadData&, rtData)
 GSATT(Config&, config)
@@ -231,7 +248,9 @@ GSATT(Audio&, audio)
 GSATT(GLState&, _glState)
 GSATT(ShaderSet&, shaders)
 GSATT(TexPool&, texPool)
+GSATT(ImageCache&, imageCache)
 GSATT(Quad&, gpQuad)
+GSATT(ColorQuadArray&, gpQuadArray)
 GSATT(SharedFontState&, fontState)
 GSATT(SharedMidiState&, midiState)
 
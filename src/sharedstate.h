@@ -35,15 +35,22 @@ struct SDL_Window;
 struct TEXFBO;
 struct Quad;
 struct ShaderSet;
+struct Vertex;
+template<class VertexType> struct QuadArray;
+typedef QuadArray<Vertex> ColorQuadArray;
 
 class Scene;
 class FileSystem;
+class ImageDecoder;
+class SaveWriter;
+class Pathfinder;
 class EventThread;
 class Graphics;
 class Input;
 class Audio;
 class GLState;
 class TexPool;
+class ImageCache;
 class Font;
 class SharedFontState;
 struct GlobalIBO;
@@ -62,6 +69,9 @@ struct SharedState
 	void setScreen(Scene &screen);
 
 	FileSystem &fileSystem() const;
+	ImageDecoder &imageDecoder() const;
+	SaveWriter &saveWriter() const;
+	Pathfinder &pathfinder() const;
 
 	EventThread &eThread() const;
 	RGSSThreadData &rtData() const;
@@ -76,6 +86,7 @@ struct SharedState
 	ShaderSet &shaders() const;
 
 	TexPool &texPool() const;
+	ImageCache &imageCache() const;
 
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
@@ -99,6 +110,9 @@ struct SharedState
 
 	Quad &gpQuad() const;
 
+	/* General purpose quad array, for batched one-off draws */
+	ColorQuadArray &gpQuadArray() const;
+
 	/* Basically just a simple "TexPool"
 	 * replacement for Tilemap atlas use */
 	void requestAtlasTex(int w, int h, TEXFBO &out);
@@ -165,6 +165,49 @@ struct SpritePrivate
 				(sigc::mem_fun(this, &SpritePrivate::onSrcRectChange));
 	}
 
+	/* Mega bitmaps are drawn one tile at a time. The
+	 * wave effect is not supported for these */
+	void drawTiles(ShaderBase &shader, SpriteShader *effectShader)
+	{
+		IntRect src = srcRect->toIntRect();
+		src.w = clamp<int>(src.w, 0, bitmap->width()-src.x);
+		src.h = clamp<int>(src.h, 0, bitmap->height()-src.y);
+
+		const float bushY = efBushDepth * bitmap->height();
+
+		const std::vector<Bitmap::Tile> &tiles = bitmap->getTiles();
+		Quad &tileQuad = shState->gpQuad();
+
+		for (size_t i = 0; i < tiles.size(); ++i)
+		{
+			const Bitmap::Tile &tile = tiles[i];
+			SDL_Rect inters;
+
+			if (!SDL_IntersectRect(&src, &tile.rect, &inters))
+				continue;
+
+			FloatRect tex(inters.x - tile.rect.x, inters.y - tile.rect.y,
+			              inters.w, inters.h);
+			FloatRect pos(inters.x - src.x, inters.y - src.y,
+			              inters.w, inters.h);
+
+			if (mirrored)
+			{
+				pos.x = src.w - (pos.x + pos.w);
+				tex = tex.hFlipped();
+			}
+
+			/* Bush depth is relative to the bound texture */
+			if (effectShader)
+				effectShader->setBushDepth((bushY - tile.rect.y) / tile.rect.h);
+
+			tile.bitmap->bindTex(shader);
+
+			tileQuad.setTexPosRect(tex, pos);
+			tileQuad.draw();
+		}
+	}
+
 	void updateVisibility()
 	{
 		isVisible = false;
@@ -346,8 +389,6 @@ void Sprite::setBitmap(Bitmap *bitmap)
 	if (nullOrDisposed(bitmap))
 		return;
 
-	bitmap->ensureNonMega();
-
 	*p->srcRect = bitmap->rect();
 	p->onSrcRectChange();
 	p->quad.setPosRect(p->srcRect->toFloatRect());
@@ -573,12 +614,19 @@ void Sprite::draw()
 
 	glState.blendMode.pushSet(p->blendType);
 
-	p->bitmap->bindTex(*base);
-
-	if (p->wave.active)
-		p->wave.qArray.draw();
+	if (p->bitmap->isMega())
+	{
+		p->drawTiles(*base, renderEffect ? &shState->shaders().sprite : 0);
+	}
 	else
-		p->quad.draw();
+	{
+		p->bitmap->bindTex(*base);
+
+		if (p->wave.active)
+			p->wave.qArray.draw();
+		else
+			p->quad.draw();
+	}
 
 	glState.blendMode.pop();
 }
@@ -89,6 +89,173 @@ void Table::resize(int x)
 	resize(x, ys, zs);
 }
 
+void Table::fill(int16_t value)
+{
+	std::fill(data.begin(), data.end(), value);
+
+	modified();
+}
+
+/* Clips the span [x, x+len) to [0, size) */
+static bool clipSpan(int &x, int &len, int size)
+{
+	if (x < 0)
+	{
+		len += x;
+		x = 0;
+	}
+
+	len = std::min(len, size - x);
+
+	return len > 0;
+}
+
+void Table::fill(int16_t value, int x, int y, int z,
+                 int width, int height, int depth)
+{
+	if (!clipSpan(x, width, xs) || !clipSpan(y, height, ys) || !clipSpan(z, depth, zs))
+		return;
+
+	for (int k = z; k < z+depth; ++k)
+		for (int j = y; j < y+height; ++j)
+		{
+			int16_t *row = &at(x, j, k);
+			std::fill(row, row+width, value);
+		}
+
+	modified();
+}
+
+/* Clips a copied span to both source and destination */
+static bool clipCopySpan(int &src, int &dst, int &len,
+                         int srcSize, int dstSize)
+{
+	if (src < 0)
+	{
+		dst -= src;
+		len += src;
+		src = 0;
+	}
+
+	if (dst < 0)
+	{
+		src -= dst;
+		len += dst;
+		dst = 0;
+	}
+
+	len = std::min(len, std::min(srcSize - src, dstSize - dst));
+
+	return len > 0;
+}
+
+void Table::blit(const Table &source,
+                 int srcX, int srcY, int srcZ,
+                 int width, int height, int depth,
+                 int dstX, int dstY, int dstZ)
+{
+	if (!clipCopySpan(srcX, dstX, width,  source.xs, xs)
+	||  !clipCopySpan(srcY, dstY, height, source.ys, ys)
+	||  !clipCopySpan(srcZ, dstZ, depth,  source.zs, zs))
+	{
+		return;
+	}
+
+	/* Within this table the regions might overlap. Every row moves
+	 * by the same offset, so copying rows back to front when moving
+	 * towards the end never overwrites rows that are still to be
+	 * read; memmove takes care of overlap within a row */
+	const bool backwards = (&source == this)
+	        && (dstZ*ys + dstY > srcZ*ys + srcY);
+
+	for (int n = 0; n < depth*height; ++n)
+	{
+		const int i = backwards ? depth*height-1 - n : n;
+		const int j = i % height;
+		const int k = i / height;
+
+		memmove(&at(dstX, dstY+j, dstZ+k),
+		        &source.at(srcX, srcY+j, srcZ+k),
+		        sizeof(int16_t)*width);
+	}
+
+	modified();
+}
+
+bool Table::operator==(const Table &other) const
+{
+	if (xs != other.xs || ys != other.ys || zs != other.zs)
+		return false;
+
+	if (data.empty())
+		return true;
+
+	return memcmp(dataPtr(data), dataPtr(other.data), sizeof(int16_t)*data.size()) == 0;
+}
+
+bool Table::diff(const Table &other, int box[6]) const
+{
+	/* Tables with any zero dimension have no cells */
+	if (data.empty())
+		return false;
+
+	int minX = xs, minY = ys, minZ = zs;
+	int maxX = -1, maxY = -1, maxZ = -1;
+
+	for (int k = 0; k < zs; ++k)
+		for (int j = 0; j < ys; ++j)
+		{
+			const int16_t *row = &at(0, j, k);
+			const int16_t *otherRow = &other.at(0, j, k);
+
+			/* Skip identical rows quickly */
+			if (memcmp(row, otherRow, sizeof(int16_t)*xs) == 0)
+				continue;
+
+			int first = 0;
+			while (row[first] == otherRow[first])
+				++first;
+
+			int last = xs-1;
+			while (row[last] == otherRow[last])
+				--last;
+
+			minX = std::min(minX, first);
+			maxX = std::max(maxX, last);
+			minY = std::min(minY, j);
+			maxY = std::max(maxY, j);
+			minZ = std::min(minZ, k);
+			maxZ = std::max(maxZ, k);
+		}
+
+	if (maxX < 0)
+		return false;
+
+	box[0] = minX;
+	box[1] = minY;
+	box[2] = minZ;
+	box[3] = maxX - minX + 1;
+	box[4] = maxY - minY + 1;
+	box[5] = maxZ - minZ + 1;
+
+	return true;
+}
+
+const int16_t *Table::rawData() const
+{
+	return dataPtr(data);
+}
+
+void Table::setRawData(const int16_t *values)
+{
+	if (data.empty())
+		return;
+
+	memcpy(dataPtr(data), values, sizeof(int16_t)*data.size());
+
+	modified();
+}
+
 /* Serializable */
 int Table::serialSize() const
 {
@@ -47,6 +47,31 @@ public:
 	void resize(int x, int y);
 	void resize(int x);
 
+	/* Sets all cells / the cells of a region to 'value'.
+	 * Regions are clipped to the table */
+	void fill(int16_t value);
+	void fill(int16_t value, int x, int y, int z,
+	          int width, int height, int depth);
+
+	/* Copies the region at (srcX, srcY, srcZ) of 'source' to
+	 * (dstX, dstY, dstZ), clipped to both tables.
+	 * 'source' may be this table */
+	void blit(const Table &source,
+	          int srcX, int srcY, int srcZ,
+	          int width, int height, int depth,
+	          int dstX, int dstY, int dstZ);
+
+	bool operator==(const Table &other) const;
+
+	/* For equally sized tables, returns whether any cells differ,
+	 * and if so, the bounding box of them in 'box'
+	 * (x, y, z, width, height, depth) */
+	bool diff(const Table &other, int box[6]) const;
+
+	/* Raw cell data, xSize*ySize*zSize values */
+	const int16_t *rawData() const;
+	void setRawData(const int16_t *values);
+
 	int serialSize() const;
 	void serialize(char *buffer) const;
 	static Table *deserialize(const char *data, int len);
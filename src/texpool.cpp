@@ -68,6 +68,9 @@ struct TexPoolPrivate
 	/* Current amount of TexFBOs cached */
 	uint16_t objCount;
 
+	/* Memory of all TexFBOs handed out and not yet released */
+	uint64_t usedMemSize;
+
 	/* Has this pool been disabled? */
 	bool disabled;
 
@@ -75,6 +78,7 @@ struct TexPoolPrivate
 	    : maxMemSize(maxMemSize),
 	      memSize(0),
 	      objCount(0),
+	      usedMemSize(0),
 	      disabled(false)
 	{}
 };
@@ -121,6 +125,8 @@ TEXFBO TexPool::request(int width, int height)
 		p->memSize -= byteCount(size);
 		--p->objCount;
 
+		p->usedMemSize += byteCount(size);
+
 //		Debug() << "TexPool: <?+> (" << width << height << ")";
 
 		return cnode.obj;
@@ -137,6 +143,8 @@ TEXFBO TexPool::request(int width, int height)
 	TEXFBO::allocEmpty(cnode.obj, width, height);
 	TEXFBO::linkFBO(cnode.obj);
 
+	p->usedMemSize += byteCount(size);
+
 //	Debug() << "TexPool: <?-> (" << width << height << ")";
 
 	return cnode.obj;
@@ -150,6 +158,10 @@ void TexPool::release(TEXFBO &obj)
 		return;
 	}
 
+	Size size(obj.width, obj.height);
+
+	p->usedMemSize -= byteCount(size);
+
 	if (p->disabled)
 	{
 		/* If we're disabled, delete without caching */
@@ -158,8 +170,6 @@ void TexPool::release(TEXFBO &obj)
 		return;
 	}
 
-	Size size(obj.width, obj.height);
-
 	uint32_t newMemSize = p->memSize + byteCount(size);
 
 	/* If caching this object would spill over the allowed memory budget,
@@ -213,4 +223,9 @@ void TexPool::disable()
 	p->disabled = true;
 }
 
+uint64_t TexPool::usedMemSize() const
+{
+	return p->usedMemSize;
+}
+
 
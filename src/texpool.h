@@ -37,6 +37,10 @@ public:
 
 	void disable();
 
+	/* Bytes held by textures currently handed out
+	 * (not counting the ones cached by the pool) */
+	uint64_t usedMemSize() const;
+
 private:
 	TexPoolPrivate *p;
 };
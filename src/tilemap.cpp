@@ -427,7 +427,7 @@ struct TilemapPrivate
 			if (nullOrDisposed(autotiles[i]))
 				continue;
 
-			if (autotiles[i]->megaSurface())
+			if (autotiles[i]->isMega())
 				continue;
 
 			usableATs.push_back(i);
@@ -532,62 +532,39 @@ struct TilemapPrivate
 		GLMeta::blitEnd();
 
 		/* Blit tileset */
-		if (tileset->megaSurface())
+		if (tileset->isMega())
 		{
-			/* Mega surface tileset */
-			SDL_Surface *tsSurf = tileset->megaSurface();
+			/* Mega tileset, blit from each tile separately */
+			const std::vector<Bitmap::Tile> &tsTiles = tileset->getTiles();
 
-			if (shState->config().subImageFix)
-			{
-				/* Implementation for broken GL drivers */
-				FBO::bind(atlas.gl.fbo);
-				glState.blend.pushSet(false);
-				glState.viewport.pushSet(IntRect(0, 0, atlas.size.x, atlas.size.y));
-
-				SimpleShader &shader = shState->shaders().simple;
-				shader.bind();
-				shader.applyViewportProj();
-				shader.setTranslation(Vec2i());
-
-				Quad &quad = shState->gpQuad();
-
-				for (size_t i = 0; i < blits.size(); ++i)
-				{
-					const TileAtlas::Blit &blitOp = blits[i];
-
-					Vec2i texSize;
-					shState->ensureTexSize(tsLaneW, blitOp.h, texSize);
-					shState->bindTex();
-					GLMeta::subRectImageUpload(tsSurf->w, blitOp.src.x, blitOp.src.y,
-					                           0, 0, tsLaneW, blitOp.h, tsSurf, GL_RGBA);
-
-					shader.setTexSize(texSize);
-					quad.setTexRect(FloatRect(0, 0, tsLaneW, blitOp.h));
-					quad.setPosRect(FloatRect(blitOp.dst.x, blitOp.dst.y, tsLaneW, blitOp.h));
+			/* Make sure no pending operations are flushed mid-blit */
+			for (size_t i = 0; i < tsTiles.size(); ++i)
+				tsTiles[i].bitmap->getGLTypes();
 
-					quad.draw();
-				}
+			GLMeta::blitBegin(atlas.gl);
 
-				GLMeta::subRectImageEnd();
-				glState.viewport.pop();
-				glState.blend.pop();
-			}
-			else
+			for (size_t i = 0; i < tsTiles.size(); ++i)
 			{
-				/* Clean implementation */
-				TEX::bind(atlas.gl.tex);
+				const Bitmap::Tile &tile = tsTiles[i];
+				GLMeta::blitSource(tile.bitmap->getGLTypes());
 
-				for (size_t i = 0; i < blits.size(); ++i)
+				for (size_t j = 0; j < blits.size(); ++j)
 				{
-					const TileAtlas::Blit &blitOp = blits[i];
+					const TileAtlas::Blit &blitOp = blits[j];
+					IntRect src(blitOp.src.x, blitOp.src.y, tsLaneW, blitOp.h);
+					SDL_Rect inters;
 
-					GLMeta::subRectImageUpload(tsSurf->w, blitOp.src.x, blitOp.src.y,
-					                           blitOp.dst.x, blitOp.dst.y, tsLaneW, blitOp.h, tsSurf, GL_RGBA);
-				}
+					if (!SDL_IntersectRect(&src, &tile.rect, &inters))
+						continue;
 
-				GLMeta::subRectImageEnd();
+					GLMeta::blitRectangle(IntRect(inters.x - tile.rect.x, inters.y - tile.rect.y,
+					                              inters.w, inters.h),
+					                      Vec2i(blitOp.dst.x + (inters.x - src.x),
+					                            blitOp.dst.y + (inters.y - src.y)));
+				}
 			}
 
+			GLMeta::blitEnd();
 		}
 		else
 		{
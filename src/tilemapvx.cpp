@@ -378,6 +378,10 @@ void TilemapVX::BitmapArray::set(int i, Bitmap *bitmap)
 	if (p->bitmaps[i] == bitmap)
 		return;
 
+	/* The atlas is built with plain texture blits */
+	if (!nullOrDisposed(bitmap))
+		bitmap->ensureNonMega();
+
 	p->bitmaps[i] = bitmap;
 	p->atlasDirty = true;
 
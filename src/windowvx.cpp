@@ -908,6 +908,11 @@ void WindowVX::setWindowskin(Bitmap *value)
 
 	p->windowskin = value;
 	p->base.texDirty = true;
+
+	if (nullOrDisposed(value))
+		return;
+
+	value->ensureNonMega();
 }
 
 void WindowVX::setContents(Bitmap *value)
@@ -922,6 +927,8 @@ void WindowVX::setContents(Bitmap *value)
 	if (nullOrDisposed(value))
 		return;
 
+	value->ensureNonMega();
+
 	FloatRect rect = p->contents->rect();
 	p->contentsQuad.setTexPosRect(rect, rect);
 	p->ctrlVertDirty = true;
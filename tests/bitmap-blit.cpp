@@ -0,0 +1,300 @@
+/*
+** bitmap-blit.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Runs Bitmap operations through the engine with direct blending
+ * (the opaque area tracking and blendQuadDirect) forced on and off,
+ * and compares the results pixel by pixel.
+ *
+ * This takes the place of a script binding, so it is linked with the
+ * regular engine sources and started like the game would be. A random
+ * sequence of fills, clears, blits and text draws is applied to one
+ * destination; before each step, it is cloned and the step is run on
+ * both copies, one per blending path */
+
+#include "binding.h"
+#include "sharedstate.h"
+#include "eventthread.h"
+#include "config.h"
+#include "bitmap.h"
+#include "font.h"
+#include "etc.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SIZE 64
+#define STEPS 400
+/* Allowed difference per channel, for rounding */
+#define TOLERANCE 1
+
+/* Deterministic, so failures can be reproduced */
+static unsigned int rngState = 1;
+
+static int rnd(int max)
+{
+	rngState = rngState * 1103515245 + 12345;
+
+	return (rngState >> 16) % max;
+}
+
+static IntRect rndRect(int w, int h)
+{
+	/* Sometimes reaching past the edges */
+	int x = rnd(w + 16) - 8;
+	int y = rnd(h + 16) - 8;
+
+	return IntRect(x, y, rnd(w) + 1, rnd(h) + 1);
+}
+
+static Vec4 rndColor(bool opaque)
+{
+	return Vec4(rnd(256) / 255.0f, rnd(256) / 255.0f, rnd(256) / 255.0f,
+	            opaque ? 1.0f : rnd(256) / 255.0f);
+}
+
+static Bitmap *rndSource(int w, int h, bool opaque)
+{
+	Bitmap *bitmap = new Bitmap(w, h);
+
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x)
+			bitmap->setPixel(x, y, Color(rnd(256), rnd(256), rnd(256),
+			                             opaque ? 255 : rnd(256)));
+
+	return bitmap;
+}
+
+enum Op
+{
+	FillOpaque,
+	FillTranslucent,
+	Gradient,
+	Clear,
+	SetPixel,
+	Blt,
+	StretchBlt,
+	DrawText,
+
+	OpCount
+};
+
+static const char *opNames[] =
+{
+	"fill (opaque)", "fill (translucent)", "gradient fill", "clear rect",
+	"set pixel", "blt", "stretch blt", "draw text"
+};
+
+struct Step
+{
+	Op op;
+	IntRect rect, srcRect;
+	Vec4 color1, color2;
+	int source;
+	int opacity;
+};
+
+static Step rndStep(Bitmap *sources[], int sourceCount)
+{
+	Step step;
+	step.op = (Op) rnd(OpCount);
+	step.rect = rndRect(SIZE, SIZE);
+	step.color1 = rndColor(step.op == FillOpaque);
+	step.color2 = rndColor(false);
+	step.source = rnd(sourceCount);
+	step.srcRect = rndRect(sources[step.source]->width(), sources[step.source]->height());
+
+	/* Bias towards the interesting values */
+	const int opacities[] = { 255, 255, 128, 0, 1, 254 };
+	step.opacity = rnd(3) ? rnd(256) : opacities[rnd(6)];
+
+	return step;
+}
+
+static void runStep(Bitmap &bitmap, const Step &step, Bitmap *sources[])
+{
+	const Bitmap &source = *sources[step.source];
+
+	switch (step.op)
+	{
+	case FillOpaque :
+	case FillTranslucent :
+		bitmap.fillRect(step.rect, step.color1);
+		break;
+	case Gradient :
+		bitmap.gradientFillRect(step.rect, step.color1, step.color2, step.opacity & 1);
+		break;
+	case Clear :
+		bitmap.clearRect(step.rect);
+		break;
+	case SetPixel :
+		bitmap.setPixel(step.rect.x, step.rect.y, Color(step.color2));
+		break;
+	case Blt :
+		bitmap.blt(step.rect.x, step.rect.y, source, step.srcRect, step.opacity);
+		break;
+	case StretchBlt :
+		bitmap.stretchBlt(step.rect, source, step.srcRect, step.opacity);
+		break;
+	case DrawText :
+		bitmap.getFont().getColor().set(step.color1.x * 255, step.color1.y * 255,
+		                                step.color1.z * 255, step.opacity);
+		bitmap.drawText(step.rect, "Mkxp 123");
+		break;
+	default :
+		break;
+	}
+}
+
+static void setDirect(bool value)
+{
+	shState->config().directBlending = value;
+}
+
+/* Returns the largest difference of any channel */
+static int compare(const Bitmap &a, const Bitmap &b, int &diffX, int &diffY)
+{
+	int maxDiff = 0;
+
+	for (int y = 0; y < SIZE; ++y)
+		for (int x = 0; x < SIZE; ++x)
+		{
+			const Color ca = a.getPixel(x, y);
+			const Color cb = b.getPixel(x, y);
+
+			/* Color of fully transparent pixels doesn't matter */
+			if (ca.alpha == 0 && cb.alpha == 0)
+				continue;
+
+			const double diffs[] =
+			{
+				ca.red - cb.red, ca.green - cb.green,
+				ca.blue - cb.blue, ca.alpha - cb.alpha
+			};
+
+			for (int i = 0; i < 4; ++i)
+			{
+				int diff = abs((int) diffs[i]);
+
+				if (diff > maxDiff)
+				{
+					maxDiff = diff;
+					diffX = x;
+					diffY = y;
+				}
+			}
+		}
+
+	return maxDiff;
+}
+
+static bool runTest()
+{
+	Bitmap *sources[] =
+	{
+		rndSource(SIZE, SIZE, true),
+		rndSource(SIZE, SIZE, false),
+		rndSource(24, 24, false)
+	};
+	const int sourceCount = sizeof(sources) / sizeof(sources[0]);
+
+	Bitmap *state = new Bitmap(SIZE, SIZE);
+	int maxDiff = 0;
+	bool passed = true;
+
+	for (int i = 0; i < STEPS && passed; ++i)
+	{
+		const Step step = rndStep(sources, sourceCount);
+
+		/* Both start out identical, including their opaque areas */
+		Bitmap *direct = new Bitmap(*state);
+		Bitmap *reference = new Bitmap(*state);
+
+		setDirect(true);
+		runStep(*direct, step, sources);
+
+		setDirect(false);
+		runStep(*reference, step, sources);
+
+		int x = 0, y = 0;
+		int diff = compare(*direct, *reference, x, y);
+		maxDiff = std::max(maxDiff, diff);
+
+		if (diff > TOLERANCE)
+		{
+			printf("FAIL: step %d (%s, opacity %d): difference %d at (%d, %d)\n",
+			       i, opNames[step.op], step.opacity, diff, x, y);
+			passed = false;
+		}
+
+		delete state;
+		delete reference;
+		state = direct;
+	}
+
+	setDirect(true);
+
+	delete state;
+
+	for (int i = 0; i < sourceCount; ++i)
+		delete sources[i];
+
+	if (passed)
+		printf("All %d steps match (max difference %d)\n", STEPS, maxDiff);
+
+	return passed;
+}
+
+static void testBindingExecute()
+{
+	try
+	{
+		runTest();
+	}
+	catch (const Exception &exc)
+	{
+		printf("FAIL: %s\n", exc.msg.c_str());
+	}
+
+	fflush(stdout);
+
+	shState->rtData().rqTermAck.set();
+}
+
+static void testBindingTerminate()
+{
+
+}
+
+static void testBindingReset()
+{
+
+}
+
+ScriptBinding scriptBindingImpl =
+{
+    testBindingExecute,
+    testBindingTerminate,
+    testBindingReset
+};
+
+ScriptBinding *scriptBinding = &scriptBindingImpl;
@@ -0,0 +1,384 @@
+/*
+** blit-compare.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Compares Bitmap's direct blending paths pixel by pixel against the
+ * reference path (blending with a copy of the destination through
+ * bitmapBlit.frag), using the engine's own shaders:
+ *
+ *  - opaque destination: simpleAlpha.frag with BlendNormal
+ *  - any destination: bitmapBlitFetch.frag, if the context
+ *    supports EXT_shader_framebuffer_fetch
+ *
+ * Runs headless on an EGL pbuffer (eg. with Mesa's llvmpipe).
+ * Usage: blit-compare [shader directory] */
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <EGL/egl.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef SHADER_DIR
+#define SHADER_DIR "shader"
+#endif
+
+#define SIZE 64
+/* Allowed difference per channel, for rounding */
+#define TOLERANCE 1
+
+typedef std::vector<unsigned char> Pixels;
+
+static std::string shaderDir = SHADER_DIR;
+
+static const char vertSource[] =
+	"attribute vec2 position;\n"
+	"attribute vec2 texCoord;\n"
+	"attribute vec4 color;\n"
+	"varying vec2 v_texCoord;\n"
+	"varying vec4 v_color;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = vec4(position, 0.0, 1.0);\n"
+	"	v_texCoord = texCoord;\n"
+	"	v_color = color;\n"
+	"}\n";
+
+static std::string readFile(const std::string &path)
+{
+	std::ifstream file(path.c_str());
+
+	if (!file)
+	{
+		fprintf(stderr, "Cannot read %s\n", path.c_str());
+		exit(2);
+	}
+
+	std::stringstream ss;
+	ss << file.rdbuf();
+
+	return ss.str();
+}
+
+static GLuint compile(GLenum type, const std::string &source)
+{
+	GLuint shader = glCreateShader(type);
+	const char *src = source.c_str();
+
+	glShaderSource(shader, 1, &src, 0);
+	glCompileShader(shader);
+
+	GLint ok;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+
+	if (!ok)
+	{
+		char log[2048];
+		glGetShaderInfoLog(shader, sizeof(log), 0, log);
+		fprintf(stderr, "Shader error:\n%s\n", log);
+		exit(2);
+	}
+
+	return shader;
+}
+
+/* Prepends the same preamble as the engine does */
+static GLuint program(const char *fragName, const char *extension = 0)
+{
+	std::string frag;
+
+	if (extension)
+		frag += std::string("#extension ") + extension + " : require\n";
+
+	frag += "#define FRAGMENT_SHADER\n";
+	frag += readFile(shaderDir + "/common.h");
+	frag += readFile(shaderDir + "/" + fragName);
+
+	GLuint prog = glCreateProgram();
+	glAttachShader(prog, compile(GL_VERTEX_SHADER, readFile(shaderDir + "/common.h") + vertSource));
+	glAttachShader(prog, compile(GL_FRAGMENT_SHADER, frag));
+
+	glBindAttribLocation(prog, 0, "position");
+	glBindAttribLocation(prog, 1, "texCoord");
+	glBindAttribLocation(prog, 2, "color");
+
+	glLinkProgram(prog);
+
+	GLint ok;
+	glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+
+	if (!ok)
+	{
+		fprintf(stderr, "Link error in %s\n", fragName);
+		exit(2);
+	}
+
+	return prog;
+}
+
+static GLuint texture(const Pixels &data)
+{
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SIZE, SIZE, 0,
+	             GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+
+	return tex;
+}
+
+/* Framebuffer whose texture starts out with 'contents' */
+static GLuint target(const Pixels &contents)
+{
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+	                       GL_TEXTURE_2D, texture(contents), 0);
+	glViewport(0, 0, SIZE, SIZE);
+
+	return fbo;
+}
+
+static void drawQuad(float opacity)
+{
+	static const GLfloat pos[] = { -1, -1,  1, -1,  1, 1,  -1, 1 };
+	static const GLfloat tex[] = {  0,  0,  1,  0,  1, 1,   0, 1 };
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, pos);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, tex);
+	glVertexAttrib4f(2, 1, 1, 1, opacity);
+
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+}
+
+static Pixels readBack()
+{
+	Pixels result(SIZE * SIZE * 4);
+	glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, &result[0]);
+
+	return result;
+}
+
+static Pixels randomPixels(bool opaque)
+{
+	Pixels result(SIZE * SIZE * 4);
+
+	for (size_t i = 0; i < result.size(); ++i)
+		result[i] = rand() & 0xFF;
+
+	/* Mix in the edge cases of fully (in)visible pixels */
+	for (size_t i = 3; i < result.size(); i += 4)
+	{
+		if (opaque)
+			result[i] = 0xFF;
+		else if (i % 7 == 0)
+			result[i] = 0;
+		else if (i % 5 == 0)
+			result[i] = 0xFF;
+	}
+
+	return result;
+}
+
+static Pixels reference(GLuint prog, const Pixels &src, const Pixels &dst, float opacity)
+{
+	target(dst);
+	glUseProgram(prog);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texture(dst));
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture(src));
+
+	glUniform1i(glGetUniformLocation(prog, "source"), 0);
+	glUniform1i(glGetUniformLocation(prog, "destination"), 1);
+	glUniform4f(glGetUniformLocation(prog, "subRect"), 0, 0, 1, 1);
+	glUniform1f(glGetUniformLocation(prog, "opacity"), opacity);
+
+	glDisable(GL_BLEND);
+	drawQuad(1);
+
+	return readBack();
+}
+
+static Pixels directOpaque(GLuint prog, const Pixels &src, const Pixels &dst, float opacity)
+{
+	target(dst);
+	glUseProgram(prog);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture(src));
+	glUniform1i(glGetUniformLocation(prog, "texture"), 0);
+
+	/* BlendNormal, see GLState */
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+	                    GL_ONE,       GL_ONE_MINUS_SRC_ALPHA);
+	drawQuad(opacity);
+	glDisable(GL_BLEND);
+
+	return readBack();
+}
+
+static Pixels directFetch(GLuint prog, const Pixels &src, const Pixels &dst, float opacity)
+{
+	target(dst);
+	glUseProgram(prog);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture(src));
+	glUniform1i(glGetUniformLocation(prog, "source"), 0);
+	glUniform1f(glGetUniformLocation(prog, "opacity"), opacity);
+
+	glDisable(GL_BLEND);
+	drawQuad(1);
+
+	return readBack();
+}
+
+/* Returns the number of channels differing by more than TOLERANCE.
+ * Color channels of fully transparent results are irrelevant */
+static int compare(const char *name, const Pixels &ref, const Pixels &res, float opacity)
+{
+	int bad = 0;
+	int maxDiff = 0;
+
+	for (size_t i = 0; i < ref.size(); i += 4)
+	{
+		int channels = (ref[i+3] == 0 && res[i+3] == 0) ? 0 : 3;
+
+		for (int c = 0; c < 4; ++c)
+		{
+			if (c < 3 && c >= channels)
+				continue;
+
+			int diff = abs((int) ref[i+c] - (int) res[i+c]);
+
+			if (diff > maxDiff)
+				maxDiff = diff;
+
+			if (diff > TOLERANCE)
+				++bad;
+		}
+	}
+
+	printf("%-8s opacity %.2f: max diff %d, %d bad channels\n",
+	       name, opacity, maxDiff, bad);
+
+	return bad;
+}
+
+static bool initContext()
+{
+	EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if (!eglInitialize(dpy, 0, 0))
+		return false;
+
+	static const EGLint configAttribs[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint count;
+
+	if (!eglChooseConfig(dpy, configAttribs, &config, 1, &count) || count == 0)
+		return false;
+
+	static const EGLint surfAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+	EGLSurface surf = eglCreatePbufferSurface(dpy, config, surfAttribs);
+
+	eglBindAPI(EGL_OPENGL_API);
+	EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, 0);
+
+	if (ctx == EGL_NO_CONTEXT)
+		return false;
+
+	return eglMakeCurrent(dpy, surf, surf, ctx);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1)
+		shaderDir = argv[1];
+
+	if (!initContext())
+	{
+		fprintf(stderr, "Failed to create an EGL context\n");
+		return 2;
+	}
+
+	printf("Renderer: %s\n", glGetString(GL_RENDERER));
+
+	const char *exts = (const char*) glGetString(GL_EXTENSIONS);
+	const bool fbFetch = exts && strstr(exts, "GL_EXT_shader_framebuffer_fetch");
+
+	GLuint refProg = program("bitmapBlit.frag");
+	GLuint alphaProg = program("simpleAlpha.frag");
+	GLuint fetchProg = fbFetch ? program("bitmapBlitFetch.frag", "GL_EXT_shader_framebuffer_fetch") : 0;
+
+	static const float opacities[] = { 1.0f, 0.75f, 0.5f, 0.1f, 0.0f };
+
+	srand(1);
+	int bad = 0;
+
+	for (size_t i = 0; i < sizeof(opacities) / sizeof(opacities[0]); ++i)
+	{
+		const float op = opacities[i];
+		const Pixels src = randomPixels(false);
+
+		const Pixels opaqueDst = randomPixels(true);
+		bad += compare("opaque", reference(refProg, src, opaqueDst, op),
+		               directOpaque(alphaProg, src, opaqueDst, op), op);
+
+		if (!fbFetch)
+			continue;
+
+		const Pixels dst = randomPixels(false);
+		bad += compare("fetch", reference(refProg, src, dst, op),
+		               directFetch(fetchProg, src, dst, op), op);
+	}
+
+	if (!fbFetch)
+		printf("EXT_shader_framebuffer_fetch unavailable, fetch path not tested\n");
+
+	printf(bad ? "FAILED\n" : "OK\n");
+
+	return bad ? 1 : 0;
+}
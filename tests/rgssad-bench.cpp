@@ -0,0 +1,403 @@
+/*
+** rgssad-bench.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Micro-benchmark of RGSSAD entry reads. Generates an RGSS1 archive
+ * and reads its entry in chunks of various sizes through
+ *
+ *  - the previous implementation (seek + read + one dword xor
+ *    at a time per call), kept below for reference
+ *  - the buffered entry handle, reading from the archive file
+ *  - the buffered entry handle, reading from the mapped archive
+ *
+ * and times the keystream kernels on their own. All results are
+ * checked against the plain data, so this doubles as a test.
+ * Usage: rgssad-bench [entry size in MB] */
+
+/* For the archiver's internals */
+#include "rgssad.cpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ARCHIVE_NAME "rgssad-bench.rgssad"
+#define ENTRY_NAME "Data/Bench.rxdata"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* A PHYSFS_Io on a stdio file, standing in for PhysFS' native io */
+struct FileIo
+{
+	FILE *f;
+	std::string path;
+};
+
+static FileIo *fileIo(PHYSFS_Io *io)
+{
+	return static_cast<FileIo*>(io->opaque);
+}
+
+static PHYSFS_sint64 fileIoRead(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
+{
+	return fread(buf, 1, len, fileIo(io)->f);
+}
+
+static int fileIoSeek(PHYSFS_Io *io, PHYSFS_uint64 offset)
+{
+	return fseeko(fileIo(io)->f, offset, SEEK_SET) == 0;
+}
+
+static PHYSFS_sint64 fileIoTell(PHYSFS_Io *io)
+{
+	return ftello(fileIo(io)->f);
+}
+
+static PHYSFS_sint64 fileIoLength(PHYSFS_Io *io)
+{
+	FILE *f = fileIo(io)->f;
+	off_t pos = ftello(f);
+
+	fseeko(f, 0, SEEK_END);
+	off_t len = ftello(f);
+	fseeko(f, pos, SEEK_SET);
+
+	return len;
+}
+
+static PHYSFS_Io *createFileIo(const std::string &path);
+
+static PHYSFS_Io *fileIoDuplicate(PHYSFS_Io *io)
+{
+	return createFileIo(fileIo(io)->path);
+}
+
+static void fileIoDestroy(PHYSFS_Io *io)
+{
+	fclose(fileIo(io)->f);
+	delete fileIo(io);
+	delete io;
+}
+
+static PHYSFS_Io *createFileIo(const std::string &path)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+
+	if (!f)
+	{
+		fprintf(stderr, "Cannot open %s\n", path.c_str());
+		exit(2);
+	}
+
+	FileIo *file = new FileIo;
+	file->f = f;
+	file->path = path;
+
+	PHYSFS_Io *io = new PHYSFS_Io;
+	memset(io, 0, sizeof(*io));
+	io->read = fileIoRead;
+	io->seek = fileIoSeek;
+	io->tell = fileIoTell;
+	io->length = fileIoLength;
+	io->duplicate = fileIoDuplicate;
+	io->destroy = fileIoDestroy;
+	io->opaque = file;
+
+	return io;
+}
+
+/* The previous RGSS_ioRead, which seeked the archive and xored
+ * one dword at a time on every call */
+struct OldEntry
+{
+	RGSS_entryData data;
+	uint64_t currentOffset;
+	uint32_t currentMagic;
+	PHYSFS_Io *io;
+};
+
+static PHYSFS_sint64
+oldIoRead(OldEntry *entry, void *buffer, PHYSFS_uint64 len)
+{
+	PHYSFS_Io *io = entry->io;
+
+	uint64_t toRead = std::min<uint64_t>(entry->data.size - entry->currentOffset, len);
+	uint64_t offs = entry->currentOffset;
+
+	io->seek(io, entry->data.offset + offs);
+
+	uint8_t preAlign = 4 - (offs % 4);
+
+	if (preAlign == 4)
+		preAlign = 0;
+	else
+		preAlign = std::min<uint64_t>(preAlign, len);
+
+	uint8_t postAlign = (len > preAlign) ? (offs + len) % 4 : 0;
+
+	uint64_t align = len - (preAlign + postAlign);
+
+	uint8_t *bBufferP = static_cast<uint8_t*>(buffer);
+
+	if (preAlign > 0)
+	{
+		uint32_t dword;
+		io->read(io, &dword, preAlign);
+
+		dword <<= 8 * (offs % 4);
+		dword ^= entry->currentMagic;
+
+		dword >>= 8 * (offs % 4);
+		memcpy(bBufferP, &dword, preAlign);
+
+		bBufferP += preAlign;
+
+		if ((offs+preAlign) % 4 == 0)
+			advanceMagic(entry->currentMagic);
+	}
+
+	if (align > 0)
+	{
+		uint32_t *dwBufferP = reinterpret_cast<uint32_t*>(bBufferP);
+
+		io->read(io, bBufferP, align);
+
+		for (uint64_t i = 0; i < (align / 4); ++i)
+			dwBufferP[i] ^= advanceMagic(entry->currentMagic);
+
+		bBufferP += align;
+	}
+
+	if (postAlign > 0)
+	{
+		uint32_t dword;
+		io->read(io, &dword, postAlign);
+
+		dword ^= entry->currentMagic;
+		memcpy(bBufferP, &dword, postAlign);
+	}
+
+	entry->currentOffset += toRead;
+
+	return toRead;
+}
+
+static void writeUint32(FILE *f, uint32_t value)
+{
+	uint8_t bytes[] = { (uint8_t) value, (uint8_t) (value >> 8),
+	                    (uint8_t) (value >> 16), (uint8_t) (value >> 24) };
+
+	fwrite(bytes, 1, 4, f);
+}
+
+/* Writes an RGSS1 archive holding 'plain' as ENTRY_NAME */
+static void writeArchive(const std::vector<uint8_t> &plain)
+{
+	FILE *f = fopen(ARCHIVE_NAME, "wb");
+
+	if (!f)
+	{
+		fprintf(stderr, "Cannot write %s\n", ARCHIVE_NAME);
+		exit(2);
+	}
+
+	fwrite(RGSS_HEADER "\0\1", 1, 8, f);
+
+	uint32_t magic = RGSS_MAGIC;
+	const char *name = ENTRY_NAME;
+	const uint32_t nameLen = strlen(name);
+
+	writeUint32(f, nameLen ^ advanceMagic(magic));
+
+	for (uint32_t i = 0; i < nameLen; ++i)
+		fputc(name[i] ^ (advanceMagic(magic) & 0xFF), f);
+
+	writeUint32(f, (uint32_t) plain.size() ^ advanceMagic(magic));
+
+	/* The keystream runs independently of the old reader */
+	std::vector<uint8_t> data(plain);
+
+	for (size_t i = 0; i < data.size(); i += 4)
+	{
+		uint32_t key = advanceMagic(magic);
+
+		for (size_t j = 0; j < 4 && i+j < data.size(); ++j)
+			data[i+j] ^= (key >> (8*j)) & 0xFF;
+	}
+
+	fwrite(&data[0], 1, data.size(), f);
+	fclose(f);
+}
+
+static bool failed = false;
+
+static void check(const char *what, size_t chunk,
+                  const std::vector<uint8_t> &result, const std::vector<uint8_t> &plain)
+{
+	if (result.size() == plain.size()
+	    && memcmp(&result[0], &plain[0], plain.size()) == 0)
+		return;
+
+	printf("FAIL: %s with %zu byte reads returned wrong data\n", what, chunk);
+	failed = true;
+}
+
+static PHYSFS_sint64 readOld(void *entry, void *buffer, PHYSFS_uint64 len)
+{
+	return oldIoRead(static_cast<OldEntry*>(entry), buffer, len);
+}
+
+static PHYSFS_sint64 readIo(void *opaque, void *buffer, PHYSFS_uint64 len)
+{
+	PHYSFS_Io *io = static_cast<PHYSFS_Io*>(opaque);
+
+	return io->read(io, buffer, len);
+}
+
+/* Reads 'len' bytes in 'chunk' sized reads, returns MB/s */
+static double timeReads(PHYSFS_sint64 (*read)(void*, void*, PHYSFS_uint64), void *source,
+                        size_t len, size_t chunk, std::vector<uint8_t> &result)
+{
+	result.assign(len, 0);
+
+	double start = now();
+
+	for (size_t offs = 0; offs < len; offs += chunk)
+		read(source, &result[offs], std::min(chunk, len - offs));
+
+	return len / (now() - start) / (1024 * 1024);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t entrySize = ((argc > 1) ? atoi(argv[1]) : 16) * 1024 * 1024;
+
+	PHYSFS_init(argv[0]);
+
+	std::vector<uint8_t> plain(entrySize);
+	srand(1);
+
+	for (size_t i = 0; i < plain.size(); ++i)
+		plain[i] = rand();
+
+	writeArchive(plain);
+
+	/* One archive read through files, one mapped */
+	PHYSFS_Io *archIo = createFileIo(ARCHIVE_NAME);
+	PHYSFS_Io *mapArchIo = createFileIo(ARCHIVE_NAME);
+	int claimed = 0;
+
+	RGSS_archiveData *arch =
+	        static_cast<RGSS_archiveData*>(RGSS_openArchive(archIo, 0, 0, &claimed));
+	RGSS_archiveData *mapArch =
+	        static_cast<RGSS_archiveData*>(RGSS_openArchive(mapArchIo, ARCHIVE_NAME, 0, &claimed));
+
+	if (!arch || !mapArch || !arch->entryHash.contains(ENTRY_NAME))
+	{
+		fprintf(stderr, "Generated archive could not be opened\n");
+		return 2;
+	}
+
+	if (!mapArch->mapping)
+		printf("Note: archive could not be mapped\n");
+
+	const RGSS_entryData &entryData = arch->entryHash[ENTRY_NAME];
+
+	printf("%8s %14s %14s %14s   (MB/s, %zu MB entry)\n",
+	       "chunk", "old", "buffered", "mapped", entrySize / (1024 * 1024));
+
+	const size_t chunks[] = { 1, 3, 16, 64, 256, 4096, 65536, 1 << 20 };
+
+	for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c)
+	{
+		const size_t chunk = chunks[c];
+
+		/* Keep tiny reads from taking forever on the old path */
+		const size_t len = std::min<size_t>(entrySize, chunk * 256 * 1024);
+
+		std::vector<uint8_t> expected(plain.begin(), plain.begin() + len);
+		std::vector<uint8_t> result;
+
+		OldEntry old = { entryData, 0, entryData.startMagic, archIo->duplicate(archIo) };
+		double oldRate = timeReads(readOld, &old, len, chunk, result);
+		check("old", chunk, result, expected);
+		old.io->destroy(old.io);
+
+		PHYSFS_Io *io = RGSS_openRead(arch, ENTRY_NAME);
+		double newRate = timeReads(readIo, io, len, chunk, result);
+		check("buffered", chunk, result, expected);
+		io->destroy(io);
+
+		io = RGSS_openRead(mapArch, ENTRY_NAME);
+		double mapRate = timeReads(readIo, io, len, chunk, result);
+		check("mapped", chunk, result, expected);
+		io->destroy(io);
+
+		printf("%8zu %14.1f %14.1f %14.1f\n", chunk, oldRate, newRate, mapRate);
+	}
+
+	/* The keystream kernels alone, on data in memory */
+	std::vector<uint8_t> oldData(plain), newData(plain);
+	uint32_t oldMagic = RGSS_MAGIC, newMagic = RGSS_MAGIC;
+
+	double start = now();
+
+	uint32_t *dwords = reinterpret_cast<uint32_t*>(&oldData[0]);
+	for (size_t i = 0; i < oldData.size() / 4; ++i)
+		dwords[i] ^= advanceMagic(oldMagic);
+
+	double oldTime = now() - start;
+
+	start = now();
+	xorKeystream(&newData[0], newData.size(), newMagic);
+	double newTime = now() - start;
+
+	if (oldData != newData || oldMagic != newMagic)
+	{
+		printf("FAIL: keystream kernels disagree\n");
+		failed = true;
+	}
+
+	const double mb = entrySize / (1024.0 * 1024);
+	printf("keystream: %.1f MB/s scalar, %.1f MB/s xorKeystream\n",
+	       mb / oldTime, mb / newTime);
+
+	RGSS_closeArchive(arch);
+	RGSS_closeArchive(mapArch);
+	archIo->destroy(archIo);
+	mapArchIo->destroy(mapArchIo);
+
+	remove(ARCHIVE_NAME);
+	PHYSFS_deinit();
+
+	if (!failed)
+		printf("All reads match\n");
+
+	return failed ? 1 : 0;
+}